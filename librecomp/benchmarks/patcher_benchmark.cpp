@@ -0,0 +1,203 @@
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "librecomp/patcher.hpp"
+
+// Times patch_rom on synthetic 64MB ROMs, including the three checksums it verifies. Run with an optional iteration count.
+
+constexpr size_t rom_size = 64 * 1024 * 1024;
+
+enum class Action : uint64_t {
+    SourceRead = 0,
+    TargetRead = 1,
+    SourceCopy = 2,
+    TargetCopy = 3,
+};
+
+// Byte-at-a-time CRC32, used to build the patches and as a baseline for the patcher's own CRC.
+static uint32_t reference_crc32(const uint8_t* data, size_t size) {
+    static const std::array<uint32_t, 256> table = []() {
+        std::array<uint32_t, 256> ret{};
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+            }
+            ret[i] = crc;
+        }
+        return ret;
+    }();
+
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < size; i++) {
+        crc = (crc >> 8) ^ table[(crc ^ data[i]) & 0xFF];
+    }
+    return crc ^ 0xFFFFFFFF;
+}
+
+// Builds a BPS patch while keeping track of the target it produces.
+struct PatchWriter {
+    const std::vector<uint8_t>& rom;
+    std::vector<uint8_t> patch{ 'B', 'P', 'S', '1' };
+    std::vector<uint8_t> target{};
+    size_t target_offset = 0;
+
+    PatchWriter(const std::vector<uint8_t>& rom) : rom(rom) {
+        write_number(rom.size());
+        write_number(rom.size());
+        // No metadata.
+        write_number(0);
+        target.reserve(rom.size());
+    }
+
+    void write_number(uint64_t number) {
+        while (true) {
+            uint8_t x = number & 0x7F;
+            number >>= 7;
+            if (number == 0) {
+                patch.push_back(0x80 | x);
+                break;
+            }
+            patch.push_back(x);
+            number--;
+        }
+    }
+
+    void write_action(Action type, uint64_t length) {
+        write_number(((length - 1) << 2) | static_cast<uint64_t>(type));
+    }
+
+    void write_u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            patch.push_back(uint8_t(value >> (i * 8)));
+        }
+    }
+
+    void source_read(size_t length) {
+        write_action(Action::SourceRead, length);
+        target.insert(target.end(), rom.begin() + target.size(), rom.begin() + target.size() + length);
+    }
+
+    void target_read(const uint8_t* data, size_t length) {
+        write_action(Action::TargetRead, length);
+        patch.insert(patch.end(), data, data + length);
+        target.insert(target.end(), data, data + length);
+    }
+
+    // Repeats the output starting `distance` bytes back from the end of the target.
+    void target_copy(size_t distance, size_t length) {
+        write_action(Action::TargetCopy, length);
+        int64_t relative = int64_t(target.size() - distance) - int64_t(target_offset);
+        write_number((uint64_t(relative < 0 ? -relative : relative) << 1) | (relative < 0 ? 1 : 0));
+        size_t source = target.size() - distance;
+        for (size_t i = 0; i < length; i++) {
+            target.push_back(target[source + i]);
+        }
+        target_offset = source + length;
+    }
+
+    // Appends the checksums and returns the patch, leaving the expected target in place.
+    std::vector<uint8_t> finish() {
+        write_u32(reference_crc32(rom.data(), rom.size()));
+        write_u32(reference_crc32(target.data(), target.size()));
+        write_u32(reference_crc32(patch.data(), patch.size()));
+        return std::move(patch);
+    }
+};
+
+// Replaces 16 bytes in every 64KB of the ROM.
+static PatchWriter make_stride_patch(const std::vector<uint8_t>& rom) {
+    constexpr size_t stride = 64 * 1024;
+    constexpr size_t changed = 16;
+    std::array<uint8_t, changed> replacement;
+    replacement.fill(0xA5);
+
+    PatchWriter writer{ rom };
+    for (size_t offset = 0; offset < rom.size(); offset += stride) {
+        writer.source_read(stride - changed);
+        writer.target_read(replacement.data(), changed);
+    }
+    return writer;
+}
+
+// Fills the second half of every 1MB of the ROM with a single repeated byte, which BPS encodes as a distance-1 target copy.
+static PatchWriter make_fill_patch(const std::vector<uint8_t>& rom) {
+    constexpr size_t region = 1024 * 1024;
+    const uint8_t fill = 0xFF;
+
+    PatchWriter writer{ rom };
+    for (size_t offset = 0; offset < rom.size(); offset += region) {
+        writer.source_read(region / 2);
+        writer.target_read(&fill, 1);
+        writer.target_copy(1, region / 2 - 1);
+    }
+    return writer;
+}
+
+static void run_benchmark(const char* name, int iterations, const std::function<bool()>& func) {
+    double total_ms = 0.0;
+    double best_ms = 0.0;
+    for (int i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        if (!func()) {
+            printf("%s: failed\n", name);
+            exit(EXIT_FAILURE);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        total_ms += ms;
+        best_ms = (i == 0 || ms < best_ms) ? ms : best_ms;
+    }
+    printf("%-28s best %8.2f ms, average %8.2f ms\n", name, best_ms, total_ms / iterations);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 5;
+    if (iterations <= 0) {
+        fprintf(stderr, "Usage: %s [iterations]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> rom(rom_size);
+    uint32_t state = 0x12345678;
+    for (uint8_t& byte : rom) {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = uint8_t(state);
+    }
+
+    PatchWriter stride_writer = make_stride_patch(rom);
+    std::vector<uint8_t> stride_patch = stride_writer.finish();
+
+    PatchWriter fill_writer = make_fill_patch(rom);
+    std::vector<uint8_t> fill_patch = fill_writer.finish();
+
+    std::vector<uint8_t> output;
+    run_benchmark("byte-at-a-time CRC32", iterations, [&]() {
+        volatile uint32_t crc = reference_crc32(rom.data(), rom.size());
+        (void)crc;
+        return true;
+    });
+    run_benchmark("patch with 64KB stride", iterations, [&]() {
+        return recomp::patcher::patch_rom(rom, stride_patch, output) == recomp::patcher::PatcherResult::Success;
+    });
+    if (output != stride_writer.target) {
+        printf("patch with 64KB stride: wrong output\n");
+        return EXIT_FAILURE;
+    }
+    run_benchmark("patch with 512KB fills", iterations, [&]() {
+        return recomp::patcher::patch_rom(rom, fill_patch, output) == recomp::patcher::PatcherResult::Success;
+    });
+    if (output != fill_writer.target) {
+        printf("patch with 512KB fills: wrong output\n");
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
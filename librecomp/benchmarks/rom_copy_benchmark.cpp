@@ -0,0 +1,102 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "recomp.h"
+#include "librecomp/rdram_copy.hpp"
+
+// Times copy_to_rdram, which PI DMAs from ROM use, against copying one byte at a time through MEM_B, and checks that
+// both produce the same rdram contents for every combination of source and destination alignment.
+//
+// Usage: rom_copy_benchmark [megabytes copied per measurement]
+
+constexpr size_t rdram_size = 8 * 1024 * 1024;
+constexpr size_t rom_size = 2 * 1024 * 1024;
+constexpr gpr rdram_base = 0xFFFFFFFF80000000;
+constexpr size_t lengths[] = { 3, 16, 100, 4096, 64 * 1024, 1024 * 1024 };
+
+static void copy_to_rdram_bytewise(uint8_t* rdram, gpr ram_address, const uint8_t* src, size_t num_bytes) {
+    for (size_t i = 0; i < num_bytes; i++) {
+        MEM_B(i, ram_address) = src[i];
+    }
+}
+
+using copy_func_t = void(uint8_t* rdram, gpr ram_address, const uint8_t* src, size_t num_bytes);
+
+static bool check_outputs(const std::vector<uint8_t>& rom) {
+    std::vector<uint8_t> expected(rdram_size);
+    std::vector<uint8_t> actual(rdram_size);
+    for (size_t length : lengths) {
+        for (size_t dst_align = 0; dst_align < 4; dst_align++) {
+            for (size_t src_align = 0; src_align < 4; src_align++) {
+                // Fill rdram with a pattern so that writes outside the destination are caught.
+                std::fill(expected.begin(), expected.end(), 0xCD);
+                std::fill(actual.begin(), actual.end(), 0xCD);
+                gpr ram_address = rdram_base + 0x1000 + dst_align;
+                copy_to_rdram_bytewise(expected.data(), ram_address, rom.data() + src_align, length);
+                recomp::copy_to_rdram(actual.data(), ram_address, rom.data() + src_align, length);
+                if (expected != actual) {
+                    printf("Output mismatch for length %zu, destination alignment %zu, source alignment %zu\n", length, dst_align, src_align);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Returns the average time of one copy in nanoseconds.
+static double time_copy(copy_func_t* func, std::vector<uint8_t>& rdram, const std::vector<uint8_t>& rom, size_t length,
+    size_t dst_align, size_t src_align, size_t bytes_per_measurement)
+{
+    size_t iterations = std::max<size_t>(1, bytes_per_measurement / length);
+    // Step through the ROM so that each copy doesn't read the same cached bytes.
+    size_t src_span = rom_size - length - 4;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        size_t src_offset = ((i * length) % src_span) & ~size_t(3);
+        func(rdram.data(), rdram_base + 0x1000 + dst_align, rom.data() + src_offset + src_align, length);
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(duration).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? atoi(argv[1]) : 256;
+    if (megabytes == 0) {
+        fprintf(stderr, "Usage: %s [megabytes copied per measurement]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::vector<uint8_t> rom(rom_size);
+    uint32_t state = 0x12345678;
+    for (uint8_t& byte : rom) {
+        // xorshift32
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        byte = uint8_t(state);
+    }
+
+    if (!check_outputs(rom)) {
+        return EXIT_FAILURE;
+    }
+    printf("Outputs match for all lengths and alignments\n");
+
+    std::vector<uint8_t> rdram(rdram_size);
+    printf("%10s %9s %14s %14s %8s\n", "length", "alignment", "bytewise ns", "copy ns", "speedup");
+    for (size_t length : lengths) {
+        // Aligned, then with both the source and destination misaligned.
+        for (size_t align : { 0, 1 }) {
+            size_t dst_align = align;
+            size_t src_align = align * 3;
+            double bytewise_ns = time_copy(copy_to_rdram_bytewise, rdram, rom, length, dst_align, src_align, megabytes * 1024 * 1024);
+            double copy_ns = time_copy(recomp::copy_to_rdram, rdram, rom, length, dst_align, src_align, megabytes * 1024 * 1024);
+            printf("%10zu %4zu/%-4zu %14.1f %14.1f %7.1fx\n", length, dst_align, src_align, bytewise_ns, copy_ns, bytewise_ns / copy_ns);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -1,14 +1,50 @@
 #ifndef __RECOMP_FILES_H__
 #define __RECOMP_FILES_H__
 
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <span>
 
 namespace recomp {
+    // A read-only memory mapping of a file. Pages are loaded lazily and shared with any other mappings of the same file.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        MappedFile(const std::filesystem::path& path);
+        MappedFile(const MappedFile&) = delete;
+        MappedFile(MappedFile&& rhs) noexcept;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile& operator=(MappedFile&& rhs) noexcept;
+        ~MappedFile();
+
+        bool good() const { return data_ != nullptr; }
+        std::span<const uint8_t> data() const { return { data_, size_ }; }
+    private:
+        void close();
+
+        const uint8_t* data_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // Identifies a specific instance of a file on disk, which changes if the file is modified or replaced.
+    struct FileIdentity {
+        uint64_t size = 0;
+        uint64_t modified_time = 0;
+        uint64_t device_id = 0;
+        uint64_t file_id = 0;
+
+        bool operator==(const FileIdentity& rhs) const = default;
+    };
+
+    bool get_file_identity(const std::filesystem::path& path, FileIdentity& out);
+
     std::ifstream open_input_file_with_backup(const std::filesystem::path& filepath, std::ios_base::openmode mode = std::ios_base::in);
     std::ifstream open_input_backup_file(const std::filesystem::path& filepath, std::ios_base::openmode mode = std::ios_base::in);
     std::ofstream open_output_file_with_backup(const std::filesystem::path& filepath, std::ios_base::openmode mode = std::ios_base::out);
     bool finalize_output_file_with_backup(const std::filesystem::path& filepath);
+    // Flushes the contents of the file to disk.
+    bool sync_file(const std::filesystem::path& filepath);
 };
 
 #endif
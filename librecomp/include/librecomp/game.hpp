@@ -3,9 +3,11 @@
 
 #include <vector>
 #include <filesystem>
+#include <chrono>
 
 #include "recomp.h"
 #include "rsp.hpp"
+#include "files.hpp"
 #include <ultramodern/ultramodern.hpp>
 
 namespace recomp {
@@ -27,6 +29,9 @@ namespace recomp {
         bool is_enabled;
         // Only needed for mod function hooking support, not needed if `has_compressed_code` is false.
         std::vector<uint8_t> (*decompression_routine)(std::span<const uint8_t> compressed_rom) = nullptr;
+        // Identifies the output of `decompression_routine`. Cached decompressed ROMs are also keyed by the project version, but change this
+        // whenever the routine's output changes without a project version bump so that cached decompressed ROMs get regenerated.
+        uint32_t decompression_version = 0;
         bool has_compressed_code = false;
 
         gpr entrypoint_address;
@@ -77,11 +82,43 @@ namespace recomp {
     bool is_rom_valid(std::u8string& game_id);
     bool is_rom_loaded();
     void set_rom_contents(std::vector<uint8_t>&& new_rom);
+    void set_rom_contents(MappedFile&& new_rom);
     std::span<const uint8_t> get_rom();
     void do_rom_read(uint8_t* rdram, gpr ram_address, uint32_t physical_addr, size_t num_bytes);
     void do_rom_pio(uint8_t* rdram, gpr ram_address, uint32_t physical_addr);
     const Version& get_project_version();
 
+    enum class PiDmaMode {
+        // Transfers are performed on the thread that started them and complete immediately.
+        Synchronous,
+        // Transfers are performed on the PI DMA thread and complete as soon as the copy finishes.
+        Asynchronous,
+        // Transfers are performed on the PI DMA thread and complete once the modeled PI bus time has elapsed.
+        Modeled,
+    };
+
+    struct PiDmaControl {
+        // Synchronous by default to match the completion timing that existing titles were tested with.
+        PiDmaMode mode = PiDmaMode::Synchronous;
+        // Only used by `PiDmaMode::Modeled`. Defaults approximate a typical cartridge ROM's sustained PI bandwidth.
+        uint32_t bytes_per_second = 5 * 1024 * 1024;
+        std::chrono::microseconds setup_latency{ 10 };
+    };
+
+    struct PiDmaStats {
+        uint64_t transfer_count;
+        uint64_t bytes_transferred;
+        // Time spent by game threads starting transfers, which includes the copy itself in synchronous mode.
+        std::chrono::nanoseconds issue_time;
+        // Time spent by the PI DMA thread performing copies.
+        std::chrono::nanoseconds transfer_time;
+    };
+
+    void set_pi_dma_control(const PiDmaControl& control);
+    PiDmaStats get_pi_dma_stats();
+    void init_pi_dma();
+    void join_pi_dma_thread();
+
     /// Specify the input configuration to the recomp runtime.
     /// 
     /// The following callback fields are mandatory (i.e., fail on empty()):
@@ -100,6 +137,12 @@ namespace recomp {
         ultramodern::error_handling::callbacks_t error_handling_callbacks;
         ultramodern::threads::callbacks_t threads_callbacks;
         ultramodern::MessageQueueControl message_queue_control;
+        ultramodern::PacingControl pacing_control;
+        ultramodern::ThreadSchedulingControl thread_scheduling_control;
+        ultramodern::GfxQueueControl gfx_queue_control;
+        ultramodern::RspTaskControl rsp_task_control;
+        ultramodern::ViCatchUpControl vi_catch_up_control;
+        PiDmaControl pi_dma_control;
     };
 
     /// Start the recomp runtime.
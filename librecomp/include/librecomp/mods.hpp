@@ -62,6 +62,7 @@ namespace recomp {
     namespace mods {
         static constexpr std::string_view mods_directory = "mods";
         static constexpr std::string_view mod_config_directory = "mod_config";
+        static constexpr std::string_view rom_cache_directory = "rom_cache";
 
         enum class ModOpenError {
             Good,
@@ -377,6 +378,7 @@ namespace recomp {
             ConfigValueVariant get_mod_config_value(const std::string &mod_id, const std::string &option_id) const;
             void set_mods_config_path(const std::filesystem::path &path);
             void set_mod_config_directory(const std::filesystem::path &path);
+            void set_rom_cache_directory(const std::filesystem::path &path);
             ModContentTypeId register_content_type(const ModContentType& type);
             bool register_container_type(const std::string& extension, const std::vector<ModContentTypeId>& content_types, bool requires_manifest);
             ModContentTypeId get_code_content_type() const { return code_content_type_id; }
@@ -425,6 +427,7 @@ namespace recomp {
             moodycamel::BlockingConcurrentQueue<ModConfigQueueVariant> mod_configuration_thread_queue;
             std::filesystem::path mods_config_path;
             std::filesystem::path mod_config_directory;
+            std::filesystem::path rom_cache_directory;
             mutable std::mutex mod_config_storage_mutex;
             std::vector<size_t> loaded_code_mods;
             // Code handle for vanilla code that was regenerated to add hooks.
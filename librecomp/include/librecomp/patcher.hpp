@@ -7,6 +7,9 @@
 
 namespace recomp {
     namespace patcher {
+        // Identifies the behavior of the patcher. Increment this if a change could alter the output of `patch_rom` so that cached patched ROMs get regenerated.
+        constexpr uint32_t patcher_version = 2;
+
         enum class PatcherResult {
             Success,
             InvalidPatchFile,
@@ -14,6 +17,8 @@ namespace recomp {
         };
 
         PatcherResult patch_rom(std::span<const uint8_t> rom, std::span<const uint8_t> patch_data, std::vector<uint8_t>& patched_rom_out);
+        // Checks whether the given data is the output of the given patch, using the target size and checksum recorded in the patch.
+        bool matches_patch_target(std::span<const uint8_t> patch_data, std::span<const uint8_t> data);
     }
 }
 
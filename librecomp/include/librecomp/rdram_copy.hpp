@@ -0,0 +1,16 @@
+#ifndef __RECOMP_RDRAM_COPY_HPP__
+#define __RECOMP_RDRAM_COPY_HPP__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "recomp.h"
+
+namespace recomp {
+    // Copies a block of big-endian data into rdram, accounting for rdram being byteswapped in 32-bit words.
+    void copy_to_rdram(uint8_t* rdram, gpr ram_address, const uint8_t* src, size_t num_bytes);
+    // Copies a block of rdram out into big-endian data. The inverse of `copy_to_rdram`.
+    void copy_from_rdram(uint8_t* rdram, uint8_t* dst, gpr ram_address, size_t num_bytes);
+}
+
+#endif
@@ -6,6 +6,7 @@
 #include "rsp_vu.hpp"
 #include "recomp.h"
 #include "ultramodern/ultra64.h"
+#include "ultramodern/rsp.hpp"
 
 // TODO: Move these to recomp namespace?
 
@@ -33,18 +34,30 @@ struct RspContext {
 };
 
 using RspUcodeFunc = RspExitReason(uint8_t* rdram, uint32_t ucode_addr);
+// Microcode that takes DMEM as a parameter, which allows several RSP task executors to run microcode concurrently. The
+// parameter must be named `dmem` so that the RSP memory macros below use it instead of the global DMEM, and the microcode
+// must set its `RSP::dmem` to it for the vector loads and stores.
+using RspUcodeDmemFunc = RspExitReason(uint8_t* rdram, uint32_t ucode_addr, uint8_t* dmem);
 
 extern uint8_t dmem[];
 extern uint16_t rspReciprocals[512];
 extern uint16_t rspInverseSquareRoots[512];
 
+// These macros access whichever `dmem` is in scope where they're used: the global DMEM, or the DMEM parameter of
+// microcode with the `RspUcodeDmemFunc` signature.
 #define RSP_MEM_B(offset, addr) \
     (*reinterpret_cast<int8_t*>(dmem + (0xFFF & (((offset) + (addr)) ^ 3))))
 
 #define RSP_MEM_BU(offset, addr) \
     (*reinterpret_cast<uint8_t*>(dmem + (0xFFF & (((offset) + (addr)) ^ 3))))
 
-static inline uint32_t RSP_MEM_W_LOAD(uint32_t offset, uint32_t addr) {
+#define RSP_MEM_W_LOAD(offset, addr) rsp_mem_w_load(dmem, (offset), (addr))
+#define RSP_MEM_W_STORE(offset, addr, val) rsp_mem_w_store(dmem, (offset), (addr), (val))
+#define RSP_MEM_HU_LOAD(offset, addr) rsp_mem_hu_load(dmem, (offset), (addr))
+#define RSP_MEM_H_LOAD(offset, addr) rsp_mem_h_load(dmem, (offset), (addr))
+#define RSP_MEM_H_STORE(offset, addr, val) rsp_mem_h_store(dmem, (offset), (addr), (val))
+
+static inline uint32_t rsp_mem_w_load(uint8_t* dmem, uint32_t offset, uint32_t addr) {
     uint32_t out;
     for (int i = 0; i < 4; i++) {
         reinterpret_cast<uint8_t*>(&out)[i ^ 3] = RSP_MEM_BU(offset + i, addr);
@@ -52,13 +65,13 @@ static inline uint32_t RSP_MEM_W_LOAD(uint32_t offset, uint32_t addr) {
     return out;
 }
 
-static inline void RSP_MEM_W_STORE(uint32_t offset, uint32_t addr, uint32_t val) {
+static inline void rsp_mem_w_store(uint8_t* dmem, uint32_t offset, uint32_t addr, uint32_t val) {
     for (int i = 0; i < 4; i++) {
         RSP_MEM_BU(offset + i, addr) = reinterpret_cast<uint8_t*>(&val)[i ^ 3];
     }
 }
 
-static inline uint32_t RSP_MEM_HU_LOAD(uint32_t offset, uint32_t addr) {
+static inline uint32_t rsp_mem_hu_load(uint8_t* dmem, uint32_t offset, uint32_t addr) {
     uint16_t out;
     for (int i = 0; i < 2; i++) {
         reinterpret_cast<uint8_t*>(&out)[(i + 2) ^ 3] = RSP_MEM_BU(offset + i, addr);
@@ -66,7 +79,7 @@ static inline uint32_t RSP_MEM_HU_LOAD(uint32_t offset, uint32_t addr) {
     return out;
 }
 
-static inline uint32_t RSP_MEM_H_LOAD(uint32_t offset, uint32_t addr) {
+static inline uint32_t rsp_mem_h_load(uint8_t* dmem, uint32_t offset, uint32_t addr) {
     int16_t out;
     for (int i = 0; i < 2; i++) {
         reinterpret_cast<uint8_t*>(&out)[(i + 2) ^ 3] = RSP_MEM_BU(offset + i, addr);
@@ -74,7 +87,7 @@ static inline uint32_t RSP_MEM_H_LOAD(uint32_t offset, uint32_t addr) {
     return out;
 }
 
-static inline void RSP_MEM_H_STORE(uint32_t offset, uint32_t addr, uint32_t val) {
+static inline void rsp_mem_h_store(uint8_t* dmem, uint32_t offset, uint32_t addr, uint32_t val) {
     for (int i = 0; i < 2; i++) {
         RSP_MEM_BU(offset + i, addr) = reinterpret_cast<uint8_t*>(&val)[(i + 2) ^ 3];
     }
@@ -91,10 +104,10 @@ static inline void RSP_MEM_H_STORE(uint32_t offset, uint32_t addr, uint32_t val)
 
 #define SET_DMA_MEM(mem_addr) dma_mem_address = (mem_addr)
 #define SET_DMA_DRAM(dram_addr) dma_dram_address = (dram_addr)
-#define DO_DMA_READ(rd_len) dma_rdram_to_dmem(rdram, dma_mem_address, dma_dram_address, (rd_len))
-#define DO_DMA_WRITE(wr_len) dma_dmem_to_rdram(rdram, dma_mem_address, dma_dram_address, (wr_len))
+#define DO_DMA_READ(rd_len) dma_rdram_to_dmem(rdram, dmem, dma_mem_address, dma_dram_address, (rd_len))
+#define DO_DMA_WRITE(wr_len) dma_dmem_to_rdram(rdram, dmem, dma_mem_address, dma_dram_address, (wr_len))
 
-static inline void dma_rdram_to_dmem(uint8_t* rdram, uint32_t dmem_addr, uint32_t dram_addr, uint32_t rd_len) {
+static inline void dma_rdram_to_dmem(uint8_t* rdram, uint8_t* dmem, uint32_t dmem_addr, uint32_t dram_addr, uint32_t rd_len) {
     rd_len += 1; // Read length is inclusive
     dram_addr &= 0xFFFFF8;
     assert(dmem_addr + rd_len <= 0x1000);
@@ -103,7 +116,7 @@ static inline void dma_rdram_to_dmem(uint8_t* rdram, uint32_t dmem_addr, uint32_
     }
 }
 
-static inline void dma_dmem_to_rdram(uint8_t* rdram, uint32_t dmem_addr, uint32_t dram_addr, uint32_t wr_len) {
+static inline void dma_dmem_to_rdram(uint8_t* rdram, uint8_t* dmem, uint32_t dmem_addr, uint32_t dram_addr, uint32_t wr_len) {
     wr_len += 1; // Write length is inclusive
     dram_addr &= 0xFFFFF8;
     assert(dmem_addr + wr_len <= 0x1000);
@@ -112,6 +125,15 @@ static inline void dma_dmem_to_rdram(uint8_t* rdram, uint32_t dmem_addr, uint32_
     }
 }
 
+// Overloads that use the global DMEM, for callers that don't pass it explicitly.
+static inline void dma_rdram_to_dmem(uint8_t* rdram, uint32_t dmem_addr, uint32_t dram_addr, uint32_t rd_len) {
+    dma_rdram_to_dmem(rdram, dmem, dmem_addr, dram_addr, rd_len);
+}
+
+static inline void dma_dmem_to_rdram(uint8_t* rdram, uint32_t dmem_addr, uint32_t dram_addr, uint32_t wr_len) {
+    dma_dmem_to_rdram(rdram, dmem, dmem_addr, dram_addr, wr_len);
+}
+
 namespace recomp {
     namespace rsp {
         struct callbacks_t {
@@ -125,6 +147,16 @@ namespace recomp {
              * This function is allowed to return `nullptr` if no microcode matches the specified task. In this case a message will be printed to stderr and the program will exit.
              */
             get_rsp_microcode_t* get_rsp_microcode;
+
+            using get_rsp_microcode_dmem_t = RspUcodeDmemFunc*(const OSTask* task);
+
+            /**
+             * Optional. Same as `get_rsp_microcode`, but returns microcode that takes DMEM as a parameter, which is required for
+             * RSP tasks to run concurrently on more than one executor (see `ultramodern::RspTaskControl::executor_count`).
+             *
+             * Takes precedence over `get_rsp_microcode` for tasks run by RSP task executors.
+             */
+            get_rsp_microcode_dmem_t* get_rsp_microcode_dmem;
         };
 
         void set_callbacks(const callbacks_t& callbacks);
@@ -132,6 +164,7 @@ namespace recomp {
         void constants_init();
 
         bool run_task(uint8_t* rdram, const OSTask* task);
+        bool run_executor_task(uint8_t* rdram, const OSTask* task, ultramodern::rsp::ExecutorContext* executor);
     }
 }
 
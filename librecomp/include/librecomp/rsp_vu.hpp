@@ -62,6 +62,8 @@ template<u32 bits> inline auto sclip(s64 x) -> s64 {
   return ((x & m) ^ b) - b;
 }
 
+extern uint8_t dmem[];
+
 struct RSP {
     using r32 = uint32_t;
     using cr32 = const r32;
@@ -200,4 +202,7 @@ struct RSP {
     template<u8 e> inline auto VSUBC(r128& vd, cr128& vs, cr128& vt) -> void;
     template<u8 e> inline auto VXOR(r128& rd, cr128& vs, cr128& vt) -> void;
     template<u8 e> inline auto VZERO(r128& rd, cr128& vs, cr128& vt) -> void;
+
+    // DMEM accessed by the vector loads and stores. Microcode with the `RspUcodeDmemFunc` signature points this at its DMEM parameter.
+    uint8_t* dmem = ::dmem;
 };
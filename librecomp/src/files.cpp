@@ -1,5 +1,15 @@
 #include "files.hpp"
 
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
 constexpr std::u8string_view backup_suffix = u8".bak";
 constexpr std::u8string_view temp_suffix = u8".temp";
 
@@ -28,6 +38,51 @@ std::ofstream recomp::open_output_file_with_backup(const std::filesystem::path&
     return temp_file_out;
 }
 
+bool recomp::sync_file(const std::filesystem::path& filepath) {
+#ifdef _WIN32
+    HANDLE file_handle = CreateFileW(filepath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool synced = FlushFileBuffers(file_handle);
+    CloseHandle(file_handle);
+    return synced;
+#else
+    int fd = open(filepath.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+// Makes renames and links within the given directory durable.
+static bool sync_directory(const std::filesystem::path& dirpath) {
+#ifdef _WIN32
+    // Windows doesn't support syncing directories, instead renames are made durable by MOVEFILE_WRITE_THROUGH.
+    return true;
+#else
+    int fd = open(dirpath.empty() ? "." : dirpath.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#endif
+}
+
+// Atomically replaces `to` with `from`.
+static bool replace_file(const std::filesystem::path& from, const std::filesystem::path& to) {
+#ifdef _WIN32
+    return MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+    return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
 bool recomp::finalize_output_file_with_backup(const std::filesystem::path& filepath) {
     std::filesystem::path backup_path{filepath};
     backup_path += backup_suffix;
@@ -35,17 +90,154 @@ bool recomp::finalize_output_file_with_backup(const std::filesystem::path& filep
     std::filesystem::path temp_path{filepath};
     temp_path += temp_suffix;
 
+    // Make sure the new contents are on disk before they replace the existing file.
+    if (!sync_file(temp_path)) {
+        return false;
+    }
+
     std::error_code ec;
     if (std::filesystem::exists(filepath, ec)) {
-        std::filesystem::copy_file(filepath, backup_path, std::filesystem::copy_options::overwrite_existing, ec);
+        // Keep the existing file as the backup. Hard link it so that the file stays in place until the new one replaces it.
+        std::filesystem::remove(backup_path, ec);
+        std::filesystem::create_hard_link(filepath, backup_path, ec);
         if (ec) {
-            return false;
+            // Hard links aren't supported on every filesystem, so fall back to moving the file. Readers fall back
+            // to the backup file until the new file is moved into place.
+            if (!replace_file(filepath, backup_path)) {
+                return false;
+            }
         }
     }
-    std::filesystem::copy_file(temp_path, filepath, std::filesystem::copy_options::overwrite_existing, ec);
-    if (ec) {
+
+    if (!replace_file(temp_path, filepath)) {
+        return false;
+    }
+
+    sync_directory(filepath.parent_path());
+    return true;
+}
+
+recomp::MappedFile::MappedFile(const std::filesystem::path& path) {
+#ifdef _WIN32
+    HANDLE file_handle = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file_handle);
+        return;
+    }
+
+    HANDLE mapping_handle = CreateFileMappingW(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The view keeps the file and mapping alive, so the handles can be closed immediately.
+    CloseHandle(file_handle);
+    if (mapping_handle == nullptr) {
+        return;
+    }
+
+    void* view = MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping_handle);
+    if (view == nullptr) {
+        return;
+    }
+
+    data_ = reinterpret_cast<const uint8_t*>(view);
+    size_ = static_cast<size_t>(file_size.QuadPart);
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps the file alive, so the descriptor can be closed immediately.
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        return;
+    }
+
+    data_ = reinterpret_cast<const uint8_t*>(mapping);
+    size_ = static_cast<size_t>(file_stat.st_size);
+#endif
+}
+
+recomp::MappedFile::MappedFile(MappedFile&& rhs) noexcept {
+    data_ = rhs.data_;
+    size_ = rhs.size_;
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+}
+
+recomp::MappedFile& recomp::MappedFile::operator=(MappedFile&& rhs) noexcept {
+    if (this != &rhs) {
+        close();
+        data_ = rhs.data_;
+        size_ = rhs.size_;
+        rhs.data_ = nullptr;
+        rhs.size_ = 0;
+    }
+    return *this;
+}
+
+recomp::MappedFile::~MappedFile() {
+    close();
+}
+
+void recomp::MappedFile::close() {
+    if (data_ == nullptr) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+#else
+    munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+}
+
+bool recomp::get_file_identity(const std::filesystem::path& path, FileIdentity& out) {
+#ifdef _WIN32
+    HANDLE file_handle = CreateFileW(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    BY_HANDLE_FILE_INFORMATION file_info;
+    BOOL got_info = GetFileInformationByHandle(file_handle, &file_info);
+    CloseHandle(file_handle);
+    if (!got_info) {
         return false;
     }
-    std::filesystem::remove(temp_path, ec);
+
+    out.size = (uint64_t(file_info.nFileSizeHigh) << 32) | file_info.nFileSizeLow;
+    out.modified_time = (uint64_t(file_info.ftLastWriteTime.dwHighDateTime) << 32) | file_info.ftLastWriteTime.dwLowDateTime;
+    out.device_id = file_info.dwVolumeSerialNumber;
+    out.file_id = (uint64_t(file_info.nFileIndexHigh) << 32) | file_info.nFileIndexLow;
+#else
+    struct stat file_stat;
+    if (stat(path.c_str(), &file_stat) == -1) {
+        return false;
+    }
+
+#   ifdef __APPLE__
+    const struct timespec& modified_time = file_stat.st_mtimespec;
+#   else
+    const struct timespec& modified_time = file_stat.st_mtim;
+#   endif
+
+    out.size = static_cast<uint64_t>(file_stat.st_size);
+    out.modified_time = static_cast<uint64_t>(modified_time.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(modified_time.tv_nsec);
+    out.device_id = static_cast<uint64_t>(file_stat.st_dev);
+    out.file_id = static_cast<uint64_t>(file_stat.st_ino);
+#endif
     return true;
 }
@@ -2,6 +2,7 @@
 #include "librecomp/mods.hpp"
 #include "librecomp/overlays.hpp"
 #include "ultramodern/error_handling.hpp"
+#include "ultramodern/threads.hpp"
 
 template<class... Ts>
 struct overloaded : Ts... { using Ts::operator()...; };
@@ -22,8 +23,19 @@ struct HookTableEntry {
 std::vector<HookTableEntry> hook_table{};
 
 // Holds the recomp context to restore after running each hook. This is a vector because a hook may end up calling another hooked function,
-// so this acts as a stack of contexts to handle that recursion.
-thread_local std::vector<recomp_context> hook_contexts = { recomp_context{} };
+// so this acts as a stack of contexts to handle that recursion. Each game thread has its own stack, which is kept in a game thread local
+// instead of a thread_local so that it follows the thread when game threads run as user-space contexts.
+static std::vector<recomp_context>& get_hook_contexts() {
+    static const uint32_t slot = ultramodern::threads::reserve_game_thread_local([](void* value) {
+        delete static_cast<std::vector<recomp_context>*>(value);
+    });
+    void* hook_contexts = ultramodern::threads::get_game_thread_local(slot);
+    if (hook_contexts == nullptr) {
+        hook_contexts = new std::vector<recomp_context>{ recomp_context{} };
+        ultramodern::threads::set_game_thread_local(slot, hook_contexts);
+    }
+    return *static_cast<std::vector<recomp_context>*>(hook_contexts);
+}
 
 void recomp::mods::run_hook(uint8_t* rdram, recomp_context* ctx, size_t hook_slot_index) {
     // Sanity check the hook slot index.
@@ -35,6 +47,7 @@ void recomp::mods::run_hook(uint8_t* rdram, recomp_context* ctx, size_t hook_slo
     }
 
     // Copy the initial context state to restore it after running each callback.
+    std::vector<recomp_context>& hook_contexts = get_hook_contexts();
     hook_contexts.emplace_back(*ctx);
 
     // Call every hook attached to the hook slot.
@@ -94,7 +107,7 @@ void recomp::mods::reset_hooks() {
 }
 
 void recomphook_get_return_s32(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(int32_t)hook_contexts.back().r2;
+    ctx->r2 = (gpr)(int32_t)get_hook_contexts().back().r2;
 }
 
 void recomphook_get_return_u32(uint8_t* rdram, recomp_context* ctx) {
@@ -106,24 +119,24 @@ void recomphook_get_return_ptr(uint8_t* rdram, recomp_context* ctx) {
 }
 
 void recomphook_get_return_s16(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(int16_t)hook_contexts.back().r2;
+    ctx->r2 = (gpr)(int16_t)get_hook_contexts().back().r2;
 }
 
 void recomphook_get_return_u16(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(uint16_t)hook_contexts.back().r2;
+    ctx->r2 = (gpr)(uint16_t)get_hook_contexts().back().r2;
 }
 
 void recomphook_get_return_s8(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(int8_t)hook_contexts.back().r2;
+    ctx->r2 = (gpr)(int8_t)get_hook_contexts().back().r2;
 }
 
 void recomphook_get_return_u8(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(uint8_t)hook_contexts.back().r2;
+    ctx->r2 = (gpr)(uint8_t)get_hook_contexts().back().r2;
 }
 
 void recomphook_get_return_s64(uint8_t* rdram, recomp_context* ctx) {
-    ctx->r2 = (gpr)(int32_t)hook_contexts.back().r2;
-    ctx->r3 = (gpr)(int32_t)hook_contexts.back().r3;
+    ctx->r2 = (gpr)(int32_t)get_hook_contexts().back().r2;
+    ctx->r3 = (gpr)(int32_t)get_hook_contexts().back().r3;
 }
 
 void recomphook_get_return_u64(uint8_t* rdram, recomp_context* ctx) {
@@ -131,12 +144,12 @@ void recomphook_get_return_u64(uint8_t* rdram, recomp_context* ctx) {
 }
 
 void recomphook_get_return_float(uint8_t* rdram, recomp_context* ctx) {
-    ctx->f0.fl = hook_contexts.back().f0.fl;
+    ctx->f0.fl = get_hook_contexts().back().f0.fl;
 }
 
 void recomphook_get_return_double(uint8_t* rdram, recomp_context* ctx) {
-    ctx->f0.fl = (gpr)(uint8_t)hook_contexts.back().f0.fl;
-    ctx->f1.fl = (gpr)(uint8_t)hook_contexts.back().f1.fl;
+    ctx->f0.fl = (gpr)(uint8_t)get_hook_contexts().back().f0.fl;
+    ctx->f1.fl = (gpr)(uint8_t)get_hook_contexts().back().f1.fl;
 }
 
 #define REGISTER_FUNC(name) recomp::overlays::register_base_export(#name, name)
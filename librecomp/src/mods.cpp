@@ -2,6 +2,9 @@
 #include <fstream>
 #include <sstream>
 #include <functional>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
 
 #include "librecomp/files.hpp"
 #include "librecomp/mods.hpp"
@@ -10,6 +13,7 @@
 #include "librecomp/patcher.hpp"
 #include "recompiler/context.h"
 #include "recompiler/live_recompiler.h"
+#include "xxHash/xxh3.h"
 
 static bool read_json(std::ifstream input_file, nlohmann::json &json_out) {
     if (!input_file.good()) {
@@ -1558,6 +1562,156 @@ void recomp::mods::ModContext::set_mod_config_directory(const std::filesystem::p
     mod_config_directory = path;
 }
 
+void recomp::mods::ModContext::set_rom_cache_directory(const std::filesystem::path &path) {
+    rom_cache_directory = path;
+}
+
+// Writes a file to the ROM cache, followed by the given trailer if any.
+static bool write_rom_cache_file(const std::filesystem::path& path, std::span<const uint8_t> data, std::span<const uint8_t> trailer = {}) {
+    // Write to a temporary file first so that an interrupted write never leaves a partial file in the cache.
+    std::filesystem::path temp_path{ path };
+    temp_path += ".temp";
+
+    {
+        std::ofstream out_file{ temp_path, std::ios::binary };
+        if (!out_file.good()) {
+            return false;
+        }
+
+        out_file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        out_file.write(reinterpret_cast<const char*>(trailer.data()), trailer.size());
+        if (!out_file.good()) {
+            out_file.close();
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return false;
+        }
+    }
+
+    // Make sure the contents are on disk before the file appears under its final name.
+    std::error_code ec;
+    if (!recomp::sync_file(temp_path)) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+
+    std::filesystem::rename(temp_path, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp_path, ec);
+        return false;
+    }
+    return true;
+}
+
+// Removes any files in the cache directory with the given prefix and extension besides the one that's currently in use.
+static void remove_stale_rom_cache_files(const std::filesystem::path& cache_directory, const std::u8string& prefix, const std::u8string& extension, const std::filesystem::path& current_path) {
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator{ cache_directory, ec }) {
+        std::u8string filename = entry.path().filename().u8string();
+        if (filename.starts_with(prefix) && filename.ends_with(extension) && entry.path() != current_path) {
+            std::filesystem::remove(entry.path(), ec);
+        }
+    }
+}
+
+// Upper bound on the total size of the patched ROMs kept in the ROM cache.
+constexpr uint64_t patched_rom_cache_budget = 1024ULL * 1024 * 1024;
+const std::u8string patched_rom_cache_extension = u8".patched";
+
+// Gets the path of the cached result of applying the given patch to the game's ROM. Patched ROMs are keyed by the hash of the
+// ROM, the hash of the patch and the version of the patcher.
+static std::filesystem::path get_patched_rom_cache_path(const std::filesystem::path& cache_directory, const recomp::GameEntry& game_entry, std::span<const uint8_t> patch_data) {
+    uint64_t patch_hash = XXH3_64bits(patch_data.data(), patch_data.size());
+    char key_str[48];
+    snprintf(key_str, sizeof(key_str), "%016" PRIX64 "_%016" PRIX64 "_%08" PRIX32, game_entry.rom_hash, patch_hash, recomp::patcher::patcher_version);
+    return cache_directory / (game_entry.game_id + u8"_" + std::u8string{ key_str, key_str + strlen(key_str) } + patched_rom_cache_extension);
+}
+
+// Removes the least recently used patched ROMs from the cache until the cache fits within its budget. The patched ROM in use is never removed.
+static void evict_patched_roms(const std::filesystem::path& cache_directory, const std::filesystem::path& current_path) {
+    struct CacheFile {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uint64_t size;
+    };
+
+    std::vector<CacheFile> cache_files;
+    uint64_t total_size = 0;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator{ cache_directory, ec }) {
+        if (!entry.is_regular_file(ec) || !entry.path().filename().u8string().ends_with(patched_rom_cache_extension)) {
+            continue;
+        }
+
+        CacheFile file{ entry.path(), entry.last_write_time(ec), entry.file_size(ec) };
+        if (ec) {
+            continue;
+        }
+        total_size += file.size;
+        if (file.path != current_path) {
+            cache_files.emplace_back(std::move(file));
+        }
+    }
+
+    std::sort(cache_files.begin(), cache_files.end(), [](const CacheFile& lhs, const CacheFile& rhs) {
+        return lhs.last_used < rhs.last_used;
+    });
+
+    for (const CacheFile& file : cache_files) {
+        if (total_size <= patched_rom_cache_budget) {
+            break;
+        }
+        if (std::filesystem::remove(file.path, ec)) {
+            total_size -= file.size;
+        }
+    }
+}
+
+// Gets the decompressed ROM for the given game. The decompressed ROM is cached on disk keyed by the ROM's hash, the project
+// version and the version of the game's decompression routine, so the decompression only runs the first time a given ROM is used.
+// Cached files end with a hash of the decompressed ROM, which is checked on load to catch truncated or corrupted files.
+static std::span<const uint8_t> get_decompressed_rom(const std::filesystem::path& cache_directory, const recomp::GameEntry& game_entry,
+    std::vector<uint8_t>& decompressed_rom_data, recomp::MappedFile& decompressed_rom_mapping)
+{
+    std::string project_version = recomp::get_project_version().to_string();
+    uint64_t project_version_hash = XXH3_64bits(project_version.data(), project_version.size());
+    char key_str[48];
+    snprintf(key_str, sizeof(key_str), "%016" PRIX64 "_%016" PRIX64 "_%08" PRIX32, game_entry.rom_hash, project_version_hash, game_entry.decompression_version);
+    std::u8string prefix = game_entry.game_id + u8"_";
+    const std::u8string extension = u8".decompressed";
+    std::filesystem::path cache_path = cache_directory / (prefix + std::u8string{ key_str, key_str + strlen(key_str) } + extension);
+
+    if (!cache_directory.empty()) {
+        decompressed_rom_mapping = recomp::MappedFile{ cache_path };
+        if (decompressed_rom_mapping.good()) {
+            std::span<const uint8_t> cached_data = decompressed_rom_mapping.data();
+            if (cached_data.size() > sizeof(uint64_t)) {
+                std::span<const uint8_t> cached_rom = cached_data.first(cached_data.size() - sizeof(uint64_t));
+                uint64_t stored_hash;
+                memcpy(&stored_hash, cached_data.data() + cached_rom.size(), sizeof(stored_hash));
+                if (XXH3_64bits(cached_rom.data(), cached_rom.size()) == stored_hash) {
+                    return cached_rom;
+                }
+            }
+            fprintf(stderr, "[WARN] Cached decompressed ROM failed verification, decompressing the ROM again\n");
+            decompressed_rom_mapping = recomp::MappedFile{};
+        }
+    }
+
+    decompressed_rom_data = game_entry.decompression_routine(recomp::get_rom());
+
+    if (!cache_directory.empty() && !decompressed_rom_data.empty()) {
+        uint64_t hash = XXH3_64bits(decompressed_rom_data.data(), decompressed_rom_data.size());
+        std::span<const uint8_t> hash_bytes{ reinterpret_cast<const uint8_t*>(&hash), sizeof(hash) };
+        if (write_rom_cache_file(cache_path, decompressed_rom_data, hash_bytes)) {
+            // Clean up decompressed ROMs from previous versions of this game's ROM, the project or its decompression routine.
+            remove_stale_rom_cache_files(cache_directory, prefix, extension, cache_path);
+        }
+    }
+
+    return decompressed_rom_data;
+}
+
 std::vector<recomp::mods::ModLoadErrorDetails> recomp::mods::ModContext::load_mods(const GameEntry& game_entry, uint8_t* rdram, int32_t load_address, uint32_t& ram_used) {
     std::vector<recomp::mods::ModLoadErrorDetails> ret{};
     ram_used = 0;
@@ -1568,11 +1722,11 @@ std::vector<recomp::mods::ModLoadErrorDetails> recomp::mods::ModContext::load_mo
 
     // Decompress the rom if needed.
     std::vector<uint8_t> decompressed_rom_data{};
+    recomp::MappedFile decompressed_rom_mapping{};
     if (game_entry.has_compressed_code) {
         if (game_entry.decompression_routine != nullptr) {
-            decompressed_rom_data = game_entry.decompression_routine(recomp::get_rom());
+            decompressed_rom = get_decompressed_rom(rom_cache_directory, game_entry, decompressed_rom_data, decompressed_rom_mapping);
         }
-        decompressed_rom = std::span{decompressed_rom_data};
     }
     // Otherwise, assign the regular rom as the decompressed rom since no decompression is needed.
     else {
@@ -1658,13 +1812,45 @@ std::vector<recomp::mods::ModLoadErrorDetails> recomp::mods::ModContext::load_mo
             return ret;
         }
         
-        auto patch_result = recomp::patcher::patch_rom(recomp::get_rom(), std::span{ reinterpret_cast<const uint8_t*>(patch_data.data()), patch_data.size() }, patched_rom);
-        if (patch_result != recomp::patcher::PatcherResult::Success) {
-            ret.emplace_back(mod.manifest.mod_id, ModLoadError::FailedToLoadPatch, std::string{});
-            return ret;
+        std::span<const uint8_t> patch_span{ reinterpret_cast<const uint8_t*>(patch_data.data()), patch_data.size() };
+        std::filesystem::path patched_rom_path{};
+        recomp::MappedFile patched_rom_mapping{};
+
+        // Use the cached patched ROM if this patch has already been applied to this ROM.
+        if (!rom_cache_directory.empty()) {
+            patched_rom_path = get_patched_rom_cache_path(rom_cache_directory, game_entry, patch_span);
+            patched_rom_mapping = recomp::MappedFile{ patched_rom_path };
+            // Check the cached ROM against the patch's target in case the file was truncated or corrupted.
+            if (patched_rom_mapping.good() && !recomp::patcher::matches_patch_target(patch_span, patched_rom_mapping.data())) {
+                fprintf(stderr, "[WARN] Cached patched ROM failed verification, patching the ROM again\n");
+                patched_rom_mapping = recomp::MappedFile{};
+            }
         }
 
-        recomp::set_rom_contents(std::move(patched_rom));
+        if (patched_rom_mapping.good()) {
+            // Mark the patched ROM as recently used for cache eviction purposes.
+            std::error_code ec;
+            std::filesystem::last_write_time(patched_rom_path, std::filesystem::file_time_type::clock::now(), ec);
+            recomp::set_rom_contents(std::move(patched_rom_mapping));
+        }
+        else {
+            auto patch_result = recomp::patcher::patch_rom(recomp::get_rom(), patch_span, patched_rom);
+            if (patch_result != recomp::patcher::PatcherResult::Success) {
+                ret.emplace_back(mod.manifest.mod_id, ModLoadError::FailedToLoadPatch, std::string{});
+                return ret;
+            }
+
+            if (!patched_rom_path.empty() && !patched_rom.empty() && write_rom_cache_file(patched_rom_path, patched_rom)) {
+                evict_patched_roms(rom_cache_directory, patched_rom_path);
+            }
+
+            recomp::set_rom_contents(std::move(patched_rom));
+        }
+
+        // Replacing the ROM contents releases the previous ROM, so refresh the view of it if it's being used as the decompressed ROM.
+        if (!game_entry.has_compressed_code) {
+            decompressed_rom = recomp::get_rom();
+        }
     }
 
     // Check that mod dependencies are met.
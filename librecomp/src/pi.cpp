@@ -4,21 +4,38 @@
 #include <cstring>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "blockingconcurrentqueue.h"
+#include "xxHash/xxh3.h"
 #include "recomp.h"
 #include "librecomp/addresses.hpp"
 #include "librecomp/game.hpp"
 #include "librecomp/files.hpp"
+#include "librecomp/rdram_copy.hpp"
 #include <ultramodern/ultra64.h>
 #include <ultramodern/ultramodern.hpp>
 
-static std::vector<uint8_t> rom;
+// The ROM is either mapped directly from the stored ROM file or held in memory if it was modified (e.g. by a mod's patch).
+static std::vector<uint8_t> rom_data;
+static recomp::MappedFile rom_mapping;
+static std::span<const uint8_t> rom;
 
 bool recomp::is_rom_loaded() {
     return !rom.empty();
 }
 
 void recomp::set_rom_contents(std::vector<uint8_t>&& new_rom) {
-    rom = std::move(new_rom);
+    rom_data = std::move(new_rom);
+    rom = rom_data;
+    rom_mapping = {};
+}
+
+void recomp::set_rom_contents(MappedFile&& new_rom) {
+    rom_mapping = std::move(new_rom);
+    rom = rom_mapping.data();
+    rom_data = {};
 }
 
 std::span<const uint8_t> recomp::get_rom() {
@@ -62,30 +79,42 @@ extern "C" void osCreatePiManager_recomp(uint8_t* rdram, recomp_context* ctx) {
 }
 
 void recomp::do_rom_read(uint8_t* rdram, gpr ram_address, uint32_t physical_addr, size_t num_bytes) {
-    // TODO use word copies when possible
-
-    // TODO handle misaligned DMA
-    assert((physical_addr & 0x1) == 0 && "Only PI DMA from aligned ROM addresses is currently supported");
-    assert((ram_address & 0x7) == 0 && "Only PI DMA to aligned RDRAM addresses is currently supported");
-    uint8_t* rom_addr = rom.data() + physical_addr - recomp::rom_base;
-    for (size_t i = 0; i < num_bytes; i++) {
-        MEM_B(i, ram_address) = *rom_addr;
-        rom_addr++;
-    }
+    // TODO handle the hardware's behavior for DMA from odd ROM addresses. This copies the exact bytes requested instead.
+    const uint8_t* rom_addr = rom.data() + physical_addr - recomp::rom_base;
+    recomp::copy_to_rdram(rdram, ram_address, rom_addr, num_bytes);
 }
 
 void recomp::do_rom_pio(uint8_t* rdram, gpr ram_address, uint32_t physical_addr) {
     assert((physical_addr & 0x3) == 0 && "PIO not 4-byte aligned in device, currently unsupported");
     assert((ram_address & 0x3) == 0 && "PIO not 4-byte aligned in RDRAM, currently unsupported");
-    uint8_t* rom_addr = rom.data() + physical_addr - recomp::rom_base;
+    const uint8_t* rom_addr = rom.data() + physical_addr - recomp::rom_base;
     MEM_B(0, ram_address) = *rom_addr++;
     MEM_B(1, ram_address) = *rom_addr++;
     MEM_B(2, ram_address) = *rom_addr++;
     MEM_B(3, ram_address) = *rom_addr++;
 }
 
+// A byte range of the save buffer that has been modified since it was last written to disk.
+struct SaveDirtyRange {
+    uint32_t offset;
+    uint32_t size;
+};
+
+// The save buffer is only ever locked for in-memory copies. The saving thread copies what it needs into its own snapshot
+// buffer and performs all file I/O from that, so game threads accessing the save never wait on the disk.
 struct {
     std::vector<char> save_buffer;
+    // The saving thread's copy of the save buffer, only accessed by the saving thread or while it's waiting for a file swap.
+    std::vector<char> save_snapshot;
+    // Ranges of the save buffer modified since the last save, guarded by `save_buffer_mutex`.
+    std::vector<SaveDirtyRange> dirty_ranges;
+    // Size of the journal file for the current save file. Only accessed by the saving thread, or while it's waiting for a file swap.
+    uint64_t journal_size;
+    // Hash of the contents of the current save file, which the journal's records apply to. Same access rules as `journal_size`.
+    uint64_t base_hash;
+    // Set when a save couldn't be written, which makes the next save write the full save buffer instead of appending to the journal.
+    // This also covers the dirty ranges that were taken by the failed save. Same access rules as `journal_size`.
+    bool compaction_required;
     std::thread saving_thread;
     std::filesystem::path save_file_path;
     moodycamel::LightweightSemaphore write_sempahore;
@@ -93,6 +122,8 @@ struct {
     moodycamel::LightweightSemaphore swap_file_pending_sempahore;
     // Used to tell the consumer thread that the saving thread is ready for a file swap.
     moodycamel::LightweightSemaphore swap_file_ready_sempahore;
+    // Used to tell the saving thread to exit.
+    std::atomic_bool exit_requested;
     std::mutex save_buffer_mutex;
 } save_context;
 
@@ -112,14 +143,63 @@ void set_save_file_path(const std::u8string& subfolder, const std::u8string& nam
     save_context.save_file_path = save_folder_path / (name + u8".bin");
 }
 
-void update_save_file() {
+// Saves are written as a journal of modified ranges that gets appended to after each save, which avoids rewriting the entire
+// save file when the game only modifies a few bytes. The journal is periodically compacted by writing the full save buffer
+// to the save file and discarding the journal. The journal starts with a header identifying the save file contents that it
+// applies to, so a journal left behind by a compaction that was interrupted after replacing the save file isn't replayed
+// over the newer save. Each journal record is a header followed by the range's data.
+struct SaveJournalHeader {
+    uint32_t magic;
+    uint32_t reserved;
+    // Hash of the save file contents that the journal's records apply to.
+    uint64_t base_hash;
+};
+
+struct SaveJournalRecordHeader {
+    uint32_t magic;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t reserved;
+    // Hash of the record's data, seeded with its offset and size.
+    uint64_t checksum;
+};
+
+constexpr uint32_t save_journal_header_magic = 0x5244484A; // "JHDR"
+constexpr uint32_t save_journal_magic = 0x4C4E524A; // "JRNL"
+
+std::filesystem::path get_save_journal_path() {
+    std::filesystem::path journal_path = ultramodern::get_save_file_path();
+    journal_path += u8".journal";
+    return journal_path;
+}
+
+uint64_t calculate_save_journal_checksum(const char* data, uint32_t offset, uint32_t size) {
+    return XXH3_64bits_withSeed(data, size, (uint64_t(offset) << 32) | size);
+}
+
+uint64_t calculate_save_base_hash(const std::vector<char>& save_data) {
+    return XXH3_64bits(save_data.data(), save_data.size());
+}
+
+void show_save_failure() {
+    ultramodern::error_handling::message_box("Failed to write to the save file. Check your file permissions and whether the save folder has been moved to Dropbox or similar, as this can cause issues.");
+}
+
+// Writes the full save buffer to the save file and discards the journal. On failure, the next save tries again.
+bool compact_save_file() {
+    {
+        std::lock_guard lock{ save_context.save_buffer_mutex };
+        save_context.save_snapshot.assign(save_context.save_buffer.begin(), save_context.save_buffer.end());
+        // Everything that's dirty is being written to the save file, so there's nothing left to journal.
+        save_context.dirty_ranges.clear();
+    }
+
     bool saving_failed = false;
     {
         std::ofstream save_file = recomp::open_output_file_with_backup(ultramodern::get_save_file_path(), std::ios_base::binary);
 
         if (save_file.good()) {
-            std::lock_guard lock{ save_context.save_buffer_mutex };
-            save_file.write(save_context.save_buffer.data(), save_context.save_buffer.size());
+            save_file.write(save_context.save_snapshot.data(), save_context.save_snapshot.size());
         }
         else {
             saving_failed = true;
@@ -128,37 +208,205 @@ void update_save_file() {
     if (!saving_failed) {
         saving_failed = !recomp::finalize_output_file_with_backup(ultramodern::get_save_file_path());
     }
-    if (saving_failed) {
-        ultramodern::error_handling::message_box("Failed to write to the save file. Check your file permissions and whether the save folder has been moved to Dropbox or similar, as this can cause issues.");
+    if (!saving_failed) {
+        // The save file now contains all of the journal's changes, so the journal can be removed. The journal no longer
+        // matches the save file, so it won't be replayed even if removing it fails, and the next append replaces it.
+        save_context.base_hash = calculate_save_base_hash(save_context.save_snapshot);
+        std::error_code ec;
+        std::filesystem::remove(get_save_journal_path(), ec);
+        save_context.journal_size = 0;
     }
+    save_context.compaction_required = saving_failed;
+    return !saving_failed;
 }
 
-extern std::atomic_bool exited;
+// Reads the journal for the current save file and applies its records to the save buffer. Replay stops at the first
+// incomplete or corrupt record, which is where a write was interrupted. Journals that belong to different save file contents
+// are skipped. Returns whether any records were applied.
+bool replay_save_journal() {
+    std::ifstream journal_file{ get_save_journal_path(), std::ios_base::binary };
+    if (!journal_file.good()) {
+        return false;
+    }
+
+    SaveJournalHeader journal_header;
+    if (!journal_file.read(reinterpret_cast<char*>(&journal_header), sizeof(journal_header)) ||
+        journal_header.magic != save_journal_header_magic || journal_header.base_hash != save_context.base_hash) {
+        return false;
+    }
+
+    bool replayed = false;
+    std::vector<char> record_data;
+    SaveJournalRecordHeader header;
+    while (journal_file.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        if (header.magic != save_journal_magic || header.size > save_context.save_buffer.size() ||
+            header.offset > save_context.save_buffer.size() - header.size) {
+            break;
+        }
+
+        record_data.resize(header.size);
+        if (!journal_file.read(record_data.data(), header.size)) {
+            break;
+        }
+
+        if (calculate_save_journal_checksum(record_data.data(), header.offset, header.size) != header.checksum) {
+            break;
+        }
+
+        std::copy(record_data.begin(), record_data.end(), save_context.save_buffer.begin() + header.offset);
+        replayed = true;
+    }
+
+    return replayed;
+}
+
+void update_save_file() {
+    std::vector<SaveDirtyRange> ranges;
+    std::vector<char> range_data;
+    {
+        std::lock_guard lock{ save_context.save_buffer_mutex };
+        ranges.swap(save_context.dirty_ranges);
+
+        // Merge overlapping and adjacent ranges so that each modified byte is written once.
+        std::sort(ranges.begin(), ranges.end(), [](const SaveDirtyRange& lhs, const SaveDirtyRange& rhs) {
+            return lhs.offset < rhs.offset;
+        });
+        size_t num_merged = 0;
+        for (const SaveDirtyRange& range : ranges) {
+            if (num_merged != 0 && range.offset <= ranges[num_merged - 1].offset + ranges[num_merged - 1].size) {
+                SaveDirtyRange& prev = ranges[num_merged - 1];
+                prev.size = std::max(prev.offset + prev.size, range.offset + range.size) - prev.offset;
+            }
+            else {
+                ranges[num_merged++] = range;
+            }
+        }
+        ranges.resize(num_merged);
+
+        for (const SaveDirtyRange& range : ranges) {
+            range_data.insert(range_data.end(), save_context.save_buffer.begin() + range.offset, save_context.save_buffer.begin() + range.offset + range.size);
+        }
+    }
+
+    if (ranges.empty() && !save_context.compaction_required) {
+        return;
+    }
+
+    // A new journal starts with a header that ties it to the current save file.
+    uint64_t append_size = ranges.size() * sizeof(SaveJournalRecordHeader) + range_data.size();
+    if (save_context.journal_size == 0) {
+        append_size += sizeof(SaveJournalHeader);
+    }
+
+    // Compact instead of appending once the journal would be larger than the save itself, or if a previous save failed.
+    if (save_context.compaction_required || save_context.journal_size + append_size > save_context.save_buffer.size()) {
+        if (!compact_save_file()) {
+            show_save_failure();
+        }
+        return;
+    }
+
+    bool saving_failed = false;
+    {
+        // Replace any journal left behind by a compaction that couldn't remove it.
+        std::ios_base::openmode mode = save_context.journal_size == 0 ? std::ios_base::trunc : std::ios_base::app;
+        std::ofstream journal_file{ get_save_journal_path(), std::ios_base::binary | mode };
+        if (journal_file.good()) {
+            if (save_context.journal_size == 0) {
+                SaveJournalHeader journal_header {
+                    .magic = save_journal_header_magic,
+                    .reserved = 0,
+                    .base_hash = save_context.base_hash,
+                };
+                journal_file.write(reinterpret_cast<const char*>(&journal_header), sizeof(journal_header));
+            }
+            const char* cur_data = range_data.data();
+            for (const SaveDirtyRange& range : ranges) {
+                SaveJournalRecordHeader header {
+                    .magic = save_journal_magic,
+                    .offset = range.offset,
+                    .size = range.size,
+                    .reserved = 0,
+                    .checksum = calculate_save_journal_checksum(cur_data, range.offset, range.size),
+                };
+                journal_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                journal_file.write(cur_data, range.size);
+                cur_data += range.size;
+            }
+            journal_file.flush();
+            saving_failed = !journal_file.good();
+        }
+        else {
+            saving_failed = true;
+        }
+    }
+
+    if (!saving_failed) {
+        saving_failed = !recomp::sync_file(get_save_journal_path());
+    }
+
+    if (saving_failed) {
+        // Cut off anything that was partially appended so that later records don't end up behind it, where replay wouldn't
+        // reach them. If that fails too, the compaction below discards the journal or forces the next save to do so.
+        std::error_code ec;
+        if (save_context.journal_size == 0) {
+            std::filesystem::remove(get_save_journal_path(), ec);
+        }
+        else {
+            std::filesystem::resize_file(get_save_journal_path(), save_context.journal_size, ec);
+        }
+
+        // Fall back to writing the full save if the journal couldn't be written.
+        if (!compact_save_file()) {
+            show_save_failure();
+        }
+        return;
+    }
+
+    save_context.journal_size += append_size;
+}
 
 void saving_thread_func(RDRAM_ARG1) {
-    while (!exited) {
-        bool save_buffer_updated = false;
-        // Repeatedly wait for a new action to be sent.
-        constexpr int64_t wait_time_microseconds = 10000;
-        constexpr int max_actions = 128;
-        int num_actions = 0;
+    ultramodern::set_native_thread_name("Saving Thread");
+    ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::Low);
 
-        // Wait up to the given timeout for a write to come in. Allow multiple writes to coalesce together into a single save.
+    while (true) {
+        // Wait for a write, file swap or shutdown request to come in.
+        save_context.write_sempahore.wait();
+        ultramodern::report_thread_wakeup();
+
+        // Wait up to the given timeout for more writes to come in. Allow multiple writes to coalesce together into a single save.
         // Cap the number of coalesced writes to guarantee that the save buffer eventually gets written out to the file even if the game
-        // is constantly sending writes.
-        while (save_context.write_sempahore.wait(wait_time_microseconds) && num_actions < max_actions) {
-            save_buffer_updated = true;
+        // is constantly sending writes. Skip coalescing if a file swap or shutdown is waiting on this thread.
+        constexpr int64_t wait_time_microseconds = 10000;
+        constexpr int max_actions = 128;
+        int num_actions = 1;
+        while (num_actions < max_actions && !save_context.exit_requested && save_context.swap_file_pending_sempahore.availableApprox() == 0 &&
+            save_context.write_sempahore.wait(wait_time_microseconds))
+        {
             num_actions++;
         }
 
-        // If an action came through that affected the save file, save the updated contents.
-        if (save_buffer_updated) {
-            update_save_file();
-        }
+        // Save any changes made to the save buffer.
+        update_save_file();
 
         if (save_context.swap_file_pending_sempahore.tryWait()) {
+            // Fold the journal into the current save file before it gets swapped out.
+            if ((save_context.journal_size != 0 || save_context.compaction_required) && !compact_save_file()) {
+                show_save_failure();
+            }
             save_context.swap_file_ready_sempahore.signal();
         }
+
+        if (save_context.exit_requested) {
+            break;
+        }
+    }
+
+    // Write out any remaining changes and fold the journal into the save file on exit.
+    update_save_file();
+    if ((save_context.journal_size != 0 || save_context.compaction_required) && !compact_save_file()) {
+        show_save_failure();
     }
 }
 
@@ -168,6 +416,7 @@ void save_write_ptr(const void* in, uint32_t offset, uint32_t count) {
     {
         std::lock_guard lock { save_context.save_buffer_mutex };
         memcpy(&save_context.save_buffer[offset], in, count);
+        save_context.dirty_ranges.emplace_back(offset, count);
     }
     
     save_context.write_sempahore.signal();
@@ -178,9 +427,8 @@ void save_write(RDRAM_ARG PTR(void) rdram_address, uint32_t offset, uint32_t cou
 
     {
         std::lock_guard lock { save_context.save_buffer_mutex };
-        for (gpr i = 0; i < count; i++) {
-            save_context.save_buffer[offset + i] = MEM_B(i, rdram_address);
-        }
+        recomp::copy_from_rdram(rdram, reinterpret_cast<uint8_t*>(&save_context.save_buffer[offset]), rdram_address, count);
+        save_context.dirty_ranges.emplace_back(offset, count);
     }
 
     save_context.write_sempahore.signal();
@@ -190,9 +438,7 @@ void save_read(RDRAM_ARG PTR(void) rdram_address, uint32_t offset, uint32_t coun
     assert(offset + count <= save_context.save_buffer.size());
 
     std::lock_guard lock { save_context.save_buffer_mutex };
-    for (gpr i = 0; i < count; i++) {
-        MEM_B(i, rdram_address) = save_context.save_buffer[offset + i];
-    }
+    recomp::copy_to_rdram(rdram, rdram_address, reinterpret_cast<const uint8_t*>(&save_context.save_buffer[offset]), count);
 }
 
 void save_clear(uint32_t start, uint32_t size, char value) {
@@ -201,6 +447,7 @@ void save_clear(uint32_t start, uint32_t size, char value) {
     {
         std::lock_guard lock { save_context.save_buffer_mutex };
         std::fill_n(save_context.save_buffer.begin() + start, size, value);
+        save_context.dirty_ranges.emplace_back(start, size);
     }
 
     save_context.write_sempahore.signal();
@@ -238,6 +485,27 @@ void read_save_file() {
         // Otherwise clear the save file to all zeroes.
         std::fill(save_context.save_buffer.begin(), save_context.save_buffer.end(), 0);
     }
+    save_file.close();
+
+    {
+        std::lock_guard lock{ save_context.save_buffer_mutex };
+        save_context.dirty_ranges.clear();
+    }
+    save_context.journal_size = 0;
+    save_context.compaction_required = false;
+    save_context.base_hash = calculate_save_base_hash(save_context.save_buffer);
+
+    // Apply any changes that were journaled but not yet compacted into the save file, then compact them so that the
+    // journal starts out empty.
+    if (replay_save_journal()) {
+        if (!compact_save_file()) {
+            show_save_failure();
+        }
+    }
+    else {
+        std::error_code ec;
+        std::filesystem::remove(get_save_journal_path(), ec);
+    }
 }
 
 void ultramodern::init_saving(RDRAM_ARG1) {
@@ -251,8 +519,9 @@ void ultramodern::init_saving(RDRAM_ARG1) {
 }
 
 void ultramodern::change_save_file(const std::u8string& subfolder, const std::u8string& name) {
-    // Tell the saving thread that a file swap is pending.
+    // Tell the saving thread that a file swap is pending and wake it up.
     save_context.swap_file_pending_sempahore.signal();
+    save_context.write_sempahore.signal();
     // Wait until the saving thread indicates it's ready to swap files.
     save_context.swap_file_ready_sempahore.wait();
     // Perform the save file swap.
@@ -262,51 +531,179 @@ void ultramodern::change_save_file(const std::u8string& subfolder, const std::u8
 
 void ultramodern::join_saving_thread() {
     if (save_context.saving_thread.joinable()) {
+        save_context.exit_requested = true;
+        save_context.write_sempahore.signal();
         save_context.saving_thread.join();
     }
 }
 
-void do_dma(RDRAM_ARG PTR(OSMesgQueue) mq, gpr rdram_address, uint32_t physical_addr, uint32_t size, uint32_t direction) {
-    // TODO asynchronous transfer
+struct PiDmaRequest {
+    uint8_t* rdram = nullptr;
+    PTR(OSMesgQueue) mq = NULLPTR;
+    gpr rdram_address = 0;
+    uint32_t physical_addr = 0;
+    uint32_t size = 0;
+    uint32_t direction = 0;
+};
+
+static struct {
+    std::thread thread;
+    moodycamel::BlockingConcurrentQueue<PiDmaRequest> request_queue{};
+    std::mutex control_mutex;
+    recomp::PiDmaControl control{};
+    // The time at which the PI bus becomes free in the bandwidth model.
+    std::chrono::high_resolution_clock::time_point bus_free_time{};
+    std::atomic_uint64_t transfer_count = 0;
+    std::atomic_uint64_t bytes_transferred = 0;
+    std::atomic_int64_t issue_time_ns = 0;
+    std::atomic_int64_t transfer_time_ns = 0;
+} pi_dma_context;
+
+void recomp::set_pi_dma_control(const PiDmaControl& control) {
+    std::lock_guard lock{ pi_dma_context.control_mutex };
+    pi_dma_context.control = control;
+}
+
+recomp::PiDmaStats recomp::get_pi_dma_stats() {
+    return PiDmaStats {
+        .transfer_count = pi_dma_context.transfer_count.load(),
+        .bytes_transferred = pi_dma_context.bytes_transferred.load(),
+        .issue_time = std::chrono::nanoseconds{ pi_dma_context.issue_time_ns.load() },
+        .transfer_time = std::chrono::nanoseconds{ pi_dma_context.transfer_time_ns.load() },
+    };
+}
+
+static recomp::PiDmaControl get_pi_dma_control() {
+    std::lock_guard lock{ pi_dma_context.control_mutex };
+    return pi_dma_context.control;
+}
+
+// Performs the data copy for a DMA request. Returns whether the transfer targeted a known region and should be completed.
+static bool perform_dma(const PiDmaRequest& request) {
+    uint8_t* rdram = request.rdram;
+    auto transfer_start = std::chrono::high_resolution_clock::now();
+    bool handled = true;
+
     // TODO implement unaligned DMA correctly
-    if (direction == 0) {
-        if (physical_addr >= recomp::rom_base) {
+    if (request.direction == 0) {
+        if (request.physical_addr >= recomp::rom_base) {
             // read cart rom
-            recomp::do_rom_read(rdram, rdram_address, physical_addr, size);
-
-            // Send a message to the mq to indicate that the transfer completed
-            ultramodern::enqueue_external_message_src(mq, 0, false, ultramodern::EventMessageSource::Pi);
-        } else if (physical_addr >= recomp::sram_base) {
-            if (!recomp::sram_allowed()) {
-                ultramodern::error_handling::message_box("Attempted to use SRAM saving with other save type");
-                ULTRAMODERN_QUICK_EXIT();
-            }
+            recomp::do_rom_read(rdram, request.rdram_address, request.physical_addr, request.size);
+        } else if (request.physical_addr >= recomp::sram_base) {
             // read sram
-            save_read(rdram, rdram_address, physical_addr - recomp::sram_base, size);
-
-            // Send a message to the mq to indicate that the transfer completed
-            ultramodern::enqueue_external_message_src(mq, 0, false, ultramodern::EventMessageSource::Pi);
+            save_read(rdram, request.rdram_address, request.physical_addr - recomp::sram_base, request.size);
         } else {
-            fprintf(stderr, "[WARN] PI DMA read from unknown region, phys address 0x%08X\n", physical_addr);
+            fprintf(stderr, "[WARN] PI DMA read from unknown region, phys address 0x%08X\n", request.physical_addr);
+            handled = false;
         }
     } else {
-        if (physical_addr >= recomp::rom_base) {
+        if (request.physical_addr >= recomp::sram_base && request.physical_addr < recomp::rom_base) {
+            // write sram
+            save_write(rdram, request.rdram_address, request.physical_addr - recomp::sram_base, request.size);
+        } else {
+            fprintf(stderr, "[WARN] PI DMA write to unknown region, phys address 0x%08X\n", request.physical_addr);
+            handled = false;
+        }
+    }
+
+    auto transfer_end = std::chrono::high_resolution_clock::now();
+    pi_dma_context.transfer_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(transfer_end - transfer_start).count();
+    if (handled) {
+        pi_dma_context.transfer_count++;
+        pi_dma_context.bytes_transferred += request.size;
+    }
+    return handled;
+}
+
+static void pi_dma_thread_func() {
+    ultramodern::set_native_thread_name("PI DMA Thread");
+    ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::High);
+
+    while (true) {
+        // Wait until a DMA request has been sent.
+        PiDmaRequest request;
+        pi_dma_context.request_queue.wait_dequeue(request);
+
+        // A null rdram pointer indicates that this thread should exit.
+        if (request.rdram == nullptr) {
+            return;
+        }
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        bool handled = perform_dma(request);
+
+        if (!handled) {
+            continue;
+        }
+
+        recomp::PiDmaControl control = get_pi_dma_control();
+        ultramodern::SpeedFactor speed = ultramodern::get_speed_factor();
+        if (control.mode == recomp::PiDmaMode::Modeled && control.bytes_per_second != 0 && !speed.uncapped) {
+            // Transfers occupy the bus back to back, so a transfer can't begin until the previous one has finished.
+            auto bus_start = std::max(start_time, pi_dma_context.bus_free_time);
+            auto bus_duration = control.setup_latency + std::chrono::microseconds{ (uint64_t)request.size * 1'000'000 / control.bytes_per_second };
+            // The bus runs in emulated time, so scale its duration to host time.
+            bus_duration = bus_duration * speed.denominator / speed.numerator;
+            pi_dma_context.bus_free_time = bus_start + bus_duration;
+            ultramodern::sleep_until(pi_dma_context.bus_free_time);
+        }
+
+        // Send a message to the mq to indicate that the transfer completed
+        ultramodern::enqueue_external_message_src(request.mq, 0, false, ultramodern::EventMessageSource::Pi);
+    }
+}
+
+void recomp::init_pi_dma() {
+    if (!pi_dma_context.thread.joinable()) {
+        pi_dma_context.thread = std::thread{ pi_dma_thread_func };
+    }
+}
+
+void recomp::join_pi_dma_thread() {
+    if (pi_dma_context.thread.joinable()) {
+        // Send a null request to indicate that the PI DMA thread should exit.
+        pi_dma_context.request_queue.enqueue(PiDmaRequest{ .rdram = nullptr });
+        pi_dma_context.thread.join();
+    }
+}
+
+void do_dma(RDRAM_ARG PTR(OSMesgQueue) mq, gpr rdram_address, uint32_t physical_addr, uint32_t size, uint32_t direction) {
+    auto issue_start = std::chrono::high_resolution_clock::now();
+
+    // Validate the transfer on the calling thread so that errors are reported from the game thread that caused them.
+    if (physical_addr >= recomp::rom_base) {
+        if (direction != 0) {
             // write cart rom
             throw std::runtime_error("ROM DMA write unimplemented");
-        } else if (physical_addr >= recomp::sram_base) {
-            if (!recomp::sram_allowed()) {
-                ultramodern::error_handling::message_box("Attempted to use SRAM saving with other save type");
-                ULTRAMODERN_QUICK_EXIT();
-            }
-            // write sram
-            save_write(rdram, rdram_address, physical_addr - recomp::sram_base, size);
+        }
+    } else if (physical_addr >= recomp::sram_base) {
+        if (!recomp::sram_allowed()) {
+            ultramodern::error_handling::message_box("Attempted to use SRAM saving with other save type");
+            ULTRAMODERN_QUICK_EXIT();
+        }
+    }
 
+    PiDmaRequest request {
+        .rdram = rdram,
+        .mq = mq,
+        .rdram_address = rdram_address,
+        .physical_addr = physical_addr,
+        .size = size,
+        .direction = direction,
+    };
+
+    if (get_pi_dma_control().mode == recomp::PiDmaMode::Synchronous || !pi_dma_context.thread.joinable()) {
+        if (perform_dma(request)) {
             // Send a message to the mq to indicate that the transfer completed
             ultramodern::enqueue_external_message_src(mq, 0, false, ultramodern::EventMessageSource::Pi);
-        } else {
-            fprintf(stderr, "[WARN] PI DMA write to unknown region, phys address 0x%08X\n", physical_addr);
         }
     }
+    else {
+        pi_dma_context.request_queue.enqueue(request);
+    }
+
+    auto issue_end = std::chrono::high_resolution_clock::now();
+    pi_dma_context.issue_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(issue_end - issue_start).count();
 }
 
 extern "C" void osPiStartDma_recomp(RDRAM_ARG recomp_context* ctx) {
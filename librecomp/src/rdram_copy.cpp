@@ -0,0 +1,114 @@
+#include <cstring>
+
+#include "recomp.h"
+#include "librecomp/rdram_copy.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PI_COPY_SIMD 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PI_COPY_SIMD 1
+#include <sse2neon.h>
+#else
+#define PI_COPY_SIMD 0
+#endif
+
+static inline uint32_t byteswap_word(uint32_t word) {
+    return (word >> 24) | ((word >> 8) & 0x0000FF00) | ((word << 8) & 0x00FF0000) | (word << 24);
+}
+
+#if PI_COPY_SIMD
+static inline __m128i byteswap_words(__m128i vec) {
+    // Swap the bytes within each 16-bit lane, then swap the 16-bit halves of each 32-bit lane.
+    vec = _mm_or_si128(_mm_slli_epi16(vec, 8), _mm_srli_epi16(vec, 8));
+    vec = _mm_shufflelo_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+    return _mm_shufflehi_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+}
+#endif
+
+// Once the destination reaches a word boundary every 32-bit word of the source maps to a single native word
+// of rdram, so the bulk of the copy is done a word (or a vector of words) at a time regardless of the source alignment.
+void recomp::copy_to_rdram(uint8_t* rdram, gpr ram_address, const uint8_t* src, size_t num_bytes) {
+    size_t i = 0;
+
+    // Copy individual bytes until the destination is word aligned.
+    while (i < num_bytes && ((ram_address + i) & 0x3) != 0) {
+        MEM_B(i, ram_address) = src[i];
+        i++;
+    }
+
+    uint8_t* dst = rdram + (ram_address + i - 0xFFFFFFFF80000000);
+
+#if PI_COPY_SIMD
+    while (num_bytes - i >= 64) {
+        __m128i vec0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0x00));
+        __m128i vec1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0x10));
+        __m128i vec2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0x20));
+        __m128i vec3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 0x30));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0x00), byteswap_words(vec0));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0x10), byteswap_words(vec1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0x20), byteswap_words(vec2));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 0x30), byteswap_words(vec3));
+        dst += 64;
+        i += 64;
+    }
+
+    while (num_bytes - i >= 16) {
+        __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), byteswap_words(vec));
+        dst += 16;
+        i += 16;
+    }
+#endif
+
+    while (num_bytes - i >= 4) {
+        uint32_t word;
+        memcpy(&word, src + i, sizeof(word));
+        word = byteswap_word(word);
+        memcpy(dst, &word, sizeof(word));
+        dst += 4;
+        i += 4;
+    }
+
+    // Copy any remaining bytes individually.
+    while (i < num_bytes) {
+        MEM_B(i, ram_address) = src[i];
+        i++;
+    }
+}
+
+void recomp::copy_from_rdram(uint8_t* rdram, uint8_t* dst, gpr ram_address, size_t num_bytes) {
+    size_t i = 0;
+
+    // Copy individual bytes until the source is word aligned.
+    while (i < num_bytes && ((ram_address + i) & 0x3) != 0) {
+        dst[i] = MEM_B(i, ram_address);
+        i++;
+    }
+
+    const uint8_t* src = rdram + (ram_address + i - 0xFFFFFFFF80000000);
+
+#if PI_COPY_SIMD
+    while (num_bytes - i >= 16) {
+        __m128i vec = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), byteswap_words(vec));
+        src += 16;
+        i += 16;
+    }
+#endif
+
+    while (num_bytes - i >= 4) {
+        uint32_t word;
+        memcpy(&word, src, sizeof(word));
+        word = byteswap_word(word);
+        memcpy(dst + i, &word, sizeof(word));
+        src += 4;
+        i += 4;
+    }
+
+    // Copy any remaining bytes individually.
+    while (i < num_bytes) {
+        dst[i] = MEM_B(i, ram_address);
+        i++;
+    }
+}
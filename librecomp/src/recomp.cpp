@@ -7,6 +7,7 @@
 #include <unordered_set>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 #include <iostream>
 #include <optional>
 #include <mutex>
@@ -14,16 +15,21 @@
 #include <cinttypes>
 #include <cuchar>
 #include <charconv>
+#include <thread>
+#include <atomic>
 
 #include "recomp.h"
 #include "librecomp/overlays.hpp"
 #include "librecomp/game.hpp"
+#include "librecomp/files.hpp"
 #include "xxHash/xxh3.h"
+#include "json/json.hpp"
 #include "ultramodern/ultramodern.hpp"
 #include "ultramodern/error_handling.hpp"
 #include "librecomp/addresses.hpp"
 #include "librecomp/mods.hpp"
 #include "recompiler/live_recompiler.h"
+#include "blockingconcurrentqueue.h"
 
 #ifdef _WIN32
 #    define WIN32_LEAN_AND_MEAN
@@ -32,6 +38,16 @@
 #    include <sys/mman.h>
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define ROM_BYTESWAP_SIMD 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define ROM_BYTESWAP_SIMD 1
+#include <sse2neon.h>
+#else
+#define ROM_BYTESWAP_SIMD 0
+#endif
+
 #if defined(_WIN32)
 #define PATHFMT "%ls"
 #else
@@ -86,8 +102,10 @@ void recomp::mods::initialize_mods() {
     N64Recomp::live_recompiler_init();
     std::filesystem::create_directories(config_path / mods_directory);
     std::filesystem::create_directories(config_path / mod_config_directory);
+    std::filesystem::create_directories(config_path / rom_cache_directory);
     mod_context->set_mods_config_path(config_path / "mods.json");
     mod_context->set_mod_config_directory(config_path / mod_config_directory);
+    mod_context->set_rom_cache_directory(config_path / rom_cache_directory);
 }
 
 void recomp::mods::register_embedded_mod(const std::string &mod_id, std::span<const uint8_t> mod_bytes) {
@@ -149,62 +167,178 @@ recomp::mods::DependencyStatus recomp::mods::is_dependency_met(size_t mod_index,
     return mod_context->is_dependency_met(mod_index, dependency_id);
 }
 
-bool check_hash(const std::vector<uint8_t>& rom_data, uint64_t expected_hash) {
+bool check_hash(std::span<const uint8_t> rom_data, uint64_t expected_hash) {
     uint64_t calculated_hash = XXH3_64bits(rom_data.data(), rom_data.size());
     return calculated_hash == expected_hash;
 }
 
-static std::vector<uint8_t> read_file(const std::filesystem::path& path) {
-    std::vector<uint8_t> ret;
+// Cache of stored ROMs that have already been validated, keyed by the identity of the stored file. Allows ROMs that
+// haven't changed since they were last validated to skip being hashed again at startup.
+constexpr std::u8string_view rom_hash_cache_filename = u8"rom_hashes.json";
+// Increment this to invalidate existing caches if the format or the way stored ROMs are validated changes.
+constexpr uint32_t rom_hash_cache_version = 1;
 
-    std::ifstream file{ path, std::ios::binary};
+struct RomHashCacheEntry {
+    recomp::FileIdentity identity;
+    uint64_t rom_hash;
+};
 
-    if (file.good()) {
-        file.seekg(0, std::ios::end);
-        ret.resize(file.tellg());
-        file.seekg(0, std::ios::beg);
+static std::mutex rom_hash_cache_mutex;
+static std::unordered_map<std::u8string, RomHashCacheEntry> rom_hash_cache;
 
-        file.read(reinterpret_cast<char*>(ret.data()), ret.size());
+static void load_rom_hash_cache() {
+    using json = nlohmann::json;
+    std::lock_guard lock{ rom_hash_cache_mutex };
+    rom_hash_cache.clear();
+
+    std::ifstream cache_file = recomp::open_input_file_with_backup(config_path / rom_hash_cache_filename);
+    if (!cache_file.good()) {
+        return;
     }
 
-    return ret;
+    json cache_json;
+    try {
+        cache_file >> cache_json;
+
+        // Discard the cache if it was written by a different version.
+        if (cache_json.at("version").get<uint32_t>() != rom_hash_cache_version ||
+            cache_json.at("project_version").get<std::string>() != project_version.to_string()) {
+            return;
+        }
+
+        for (const auto& [game_id, entry_json] : cache_json.at("roms").items()) {
+            RomHashCacheEntry entry;
+            entry.identity.size = entry_json.at("size").get<uint64_t>();
+            entry.identity.modified_time = entry_json.at("modified_time").get<uint64_t>();
+            entry.identity.device_id = entry_json.at("device_id").get<uint64_t>();
+            entry.identity.file_id = entry_json.at("file_id").get<uint64_t>();
+            entry.rom_hash = entry_json.at("hash").get<uint64_t>();
+            rom_hash_cache.emplace(std::u8string{ game_id.begin(), game_id.end() }, entry);
+        }
+    }
+    catch (json::exception&) {
+        // The cache is only an optimization, so a corrupt cache is discarded and every ROM is validated.
+        rom_hash_cache.clear();
+    }
 }
 
-bool write_file(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
-    std::ofstream out_file{ path, std::ios::binary };
+static bool save_rom_hash_cache() {
+    using json = nlohmann::json;
+    json cache_json;
+    {
+        std::lock_guard lock{ rom_hash_cache_mutex };
+        json roms_json = json::object();
+
+        for (const auto& [game_id, entry] : rom_hash_cache) {
+            roms_json[std::string{ game_id.begin(), game_id.end() }] = {
+                {"size", entry.identity.size},
+                {"modified_time", entry.identity.modified_time},
+                {"device_id", entry.identity.device_id},
+                {"file_id", entry.identity.file_id},
+                {"hash", entry.rom_hash},
+            };
+        }
+
+        cache_json["version"] = rom_hash_cache_version;
+        cache_json["project_version"] = project_version.to_string();
+        cache_json["roms"] = std::move(roms_json);
+    }
 
-    if (!out_file.good()) {
+    std::filesystem::path cache_path = config_path / rom_hash_cache_filename;
+    std::ofstream output_file = recomp::open_output_file_with_backup(cache_path);
+    if (!output_file.good()) {
         return false;
     }
 
-    out_file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    output_file << std::setw(4) << cache_json;
+    output_file.close();
 
-    return true;
+    return recomp::finalize_output_file_with_backup(cache_path);
+}
+
+// Checks whether the stored ROM with the given identity was already validated against the game's expected hash.
+static bool is_rom_hash_cached(const recomp::GameEntry& game_entry, const recomp::FileIdentity& identity) {
+    std::lock_guard lock{ rom_hash_cache_mutex };
+    auto find_it = rom_hash_cache.find(game_entry.game_id);
+    return find_it != rom_hash_cache.end() && find_it->second.identity == identity && find_it->second.rom_hash == game_entry.rom_hash;
 }
 
-bool check_stored_rom(const recomp::GameEntry& game_entry) {
-    std::vector stored_rom_data = read_file(config_path / game_entry.stored_filename());
+static void cache_rom_hash(const recomp::GameEntry& game_entry, const recomp::FileIdentity& identity) {
+    std::lock_guard lock{ rom_hash_cache_mutex };
+    rom_hash_cache.insert_or_assign(game_entry.game_id, RomHashCacheEntry{ identity, game_entry.rom_hash });
+}
+
+static void uncache_rom_hash(const recomp::GameEntry& game_entry) {
+    std::lock_guard lock{ rom_hash_cache_mutex };
+    rom_hash_cache.erase(game_entry.game_id);
+}
+
+// Hashes the stored ROM and records the result in the hash cache. The stored ROM is removed if it doesn't match.
+bool check_stored_rom(const recomp::GameEntry& game_entry, const recomp::FileIdentity& identity) {
+    bool hash_matches;
+    {
+        recomp::MappedFile stored_rom{ config_path / game_entry.stored_filename() };
+        hash_matches = check_hash(stored_rom.data(), game_entry.rom_hash);
+    }
 
-    if (!check_hash(stored_rom_data, game_entry.rom_hash)) {
+    if (!hash_matches) {
         // Incorrect hash, remove the stored ROM file if it exists.
+        uncache_rom_hash(game_entry);
         std::filesystem::remove(config_path / game_entry.stored_filename());
         return false;
     }
 
+    cache_rom_hash(game_entry, identity);
     return true;
 }
 
+static std::mutex valid_game_roms_mutex;
 static std::unordered_set<std::u8string> valid_game_roms;
 
 bool recomp::is_rom_valid(std::u8string& game_id) {
+    std::lock_guard lock{ valid_game_roms_mutex };
     return valid_game_roms.contains(game_id);
 }
 
 void recomp::check_all_stored_roms() {
+    load_rom_hash_cache();
+
+    // Stored ROMs that are unchanged since they were last validated are accepted immediately.
+    std::vector<std::pair<const recomp::GameEntry*, recomp::FileIdentity>> uncached_roms;
+    bool cache_dirty = false;
     for (const auto& cur_rom_entry: game_roms) {
-        if (check_stored_rom(cur_rom_entry.second)) {
+        recomp::FileIdentity identity;
+        if (!recomp::get_file_identity(config_path / cur_rom_entry.second.stored_filename(), identity)) {
+            // No stored ROM for this game.
+            uncache_rom_hash(cur_rom_entry.second);
+            cache_dirty = true;
+        }
+        else if (is_rom_hash_cached(cur_rom_entry.second, identity)) {
             valid_game_roms.insert(cur_rom_entry.first);
         }
+        else {
+            uncached_roms.emplace_back(&cur_rom_entry.second, identity);
+        }
+    }
+
+    // Hash the remaining ROMs in parallel, as each one is independent and bound by I/O.
+    std::vector<std::thread> hash_threads;
+    hash_threads.reserve(uncached_roms.size());
+    for (const auto& [game_entry, identity] : uncached_roms) {
+        hash_threads.emplace_back([game_entry, identity]() {
+            if (check_stored_rom(*game_entry, identity)) {
+                std::lock_guard lock{ valid_game_roms_mutex };
+                valid_game_roms.insert(game_entry->game_id);
+            }
+        });
+    }
+
+    for (std::thread& thread : hash_threads) {
+        thread.join();
+    }
+
+    if (cache_dirty || !uncached_roms.empty()) {
+        save_rom_hash_cache();
     }
 }
 
@@ -214,16 +348,32 @@ bool recomp::load_stored_rom(std::u8string& game_id) {
     if (find_it == game_roms.end()) {
         return false;
     }
-    
-    std::vector<uint8_t> stored_rom_data = read_file(config_path / find_it->second.stored_filename());
 
-    if (!check_hash(stored_rom_data, find_it->second.rom_hash)) {
-        // The ROM no longer has the right hash, delete it.
-        std::filesystem::remove(config_path / find_it->second.stored_filename());
+    std::filesystem::path stored_rom_path = config_path / find_it->second.stored_filename();
+    recomp::FileIdentity identity;
+    if (!recomp::get_file_identity(stored_rom_path, identity)) {
         return false;
     }
 
-    recomp::set_rom_contents(std::move(stored_rom_data));
+    // Map the stored ROM instead of reading it so that its pages are loaded on demand and shared between processes.
+    recomp::MappedFile stored_rom{ stored_rom_path };
+
+    // Only hash the ROM if it has changed since it was last validated.
+    if (!is_rom_hash_cached(find_it->second, identity)) {
+        if (!check_hash(stored_rom.data(), find_it->second.rom_hash)) {
+            // The ROM no longer has the right hash, delete it. The mapping must be released first for the removal to succeed on Windows.
+            stored_rom = {};
+            uncache_rom_hash(find_it->second);
+            std::filesystem::remove(stored_rom_path);
+            save_rom_hash_cache();
+            return false;
+        }
+
+        cache_rom_hash(find_it->second, identity);
+        save_rom_hash_cache();
+    }
+
+    recomp::set_rom_contents(std::move(stored_rom));
     return true;
 }
 
@@ -299,7 +449,7 @@ enum class ByteswapType {
     Invalid
 };
 
-ByteswapType check_rom_start(const std::vector<uint8_t>& rom_data) {
+ByteswapType check_rom_start(std::span<const uint8_t> rom_data) {
     if (rom_data.size() < 4) {
         return ByteswapType::Invalid;
     }
@@ -331,8 +481,37 @@ ByteswapType check_rom_start(const std::vector<uint8_t>& rom_data) {
     return ByteswapType::Invalid;
 }
 
-void byteswap_data(std::vector<uint8_t>& rom_data, size_t index_xor) {
-    for (size_t rom_pos = 0; rom_pos < rom_data.size(); rom_pos += 4) {
+// Byteswaps the data in place. The size of the data must be a multiple of 4 bytes.
+void byteswap_data(std::span<uint8_t> rom_data, ByteswapType byteswap_type) {
+    size_t rom_pos = 0;
+    size_t index_xor;
+
+    switch (byteswap_type) {
+        case ByteswapType::Byteswapped2:
+            index_xor = 1;
+            break;
+        case ByteswapType::Byteswapped4:
+            index_xor = 3;
+            break;
+        default:
+            return;
+    }
+
+#if ROM_BYTESWAP_SIMD
+    for (; rom_data.size() - rom_pos >= 16; rom_pos += 16) {
+        __m128i* vec_ptr = reinterpret_cast<__m128i*>(rom_data.data() + rom_pos);
+        __m128i vec = _mm_loadu_si128(vec_ptr);
+        // Swap the bytes within each 16-bit lane, then swap the 16-bit halves of each 32-bit lane if the data was swapped in groups of 4.
+        vec = _mm_or_si128(_mm_slli_epi16(vec, 8), _mm_srli_epi16(vec, 8));
+        if (byteswap_type == ByteswapType::Byteswapped4) {
+            vec = _mm_shufflelo_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+            vec = _mm_shufflehi_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        _mm_storeu_si128(vec_ptr, vec);
+    }
+#endif
+
+    for (; rom_pos < rom_data.size(); rom_pos += 4) {
         uint8_t temp0 = rom_data[rom_pos + 0];
         uint8_t temp1 = rom_data[rom_pos + 1];
         uint8_t temp2 = rom_data[rom_pos + 2];
@@ -345,6 +524,35 @@ void byteswap_data(std::vector<uint8_t>& rom_data, size_t index_xor) {
     }
 }
 
+// The ROM is imported in chunks so that reading and byteswapping, hashing and writing the stored copy can all run
+// concurrently on separate threads, rather than as separate passes over the entire ROM.
+constexpr size_t rom_import_chunk_size = 4 * 1024 * 1024;
+// Number of chunks that can be in flight at once, which also bounds the memory used by the import.
+constexpr size_t rom_import_chunk_count = 4;
+// Number of bytes of the ROM header to keep for diagnosing a hash mismatch.
+constexpr size_t rom_import_header_size = 0x40;
+
+struct RomImportChunk {
+    std::vector<uint8_t> data;
+    size_t size;
+    // The number of stages (hashing and writing) that still need to process this chunk before it can be reused.
+    std::atomic<uint32_t> pending_stages;
+};
+
+struct RomImportPipeline {
+    std::array<RomImportChunk, rom_import_chunk_count> chunks;
+    moodycamel::BlockingConcurrentQueue<RomImportChunk*> free_chunks;
+    moodycamel::BlockingConcurrentQueue<RomImportChunk*> hash_queue;
+    moodycamel::BlockingConcurrentQueue<RomImportChunk*> write_queue;
+    std::atomic<bool> write_failed = false;
+
+    void release_chunk(RomImportChunk* chunk) {
+        if (chunk->pending_stages.fetch_sub(1) == 1) {
+            free_chunks.enqueue(chunk);
+        }
+    }
+};
+
 recomp::RomValidationError recomp::select_rom(const std::filesystem::path& rom_path, std::u8string& game_id) {
     auto find_it = game_roms.find(game_id);
 
@@ -354,37 +562,137 @@ recomp::RomValidationError recomp::select_rom(const std::filesystem::path& rom_p
 
     const recomp::GameEntry& game_entry = find_it->second;
 
-    std::vector<uint8_t> rom_data = read_file(rom_path);
+    std::ifstream rom_file{ rom_path, std::ios::binary };
+    if (!rom_file.good()) {
+        return recomp::RomValidationError::FailedToOpen;
+    }
 
-    if (rom_data.empty()) {
+    rom_file.seekg(0, std::ios::end);
+    size_t rom_size = rom_file.tellg();
+    rom_file.seekg(0, std::ios::beg);
+
+    if (rom_size == 0) {
         return recomp::RomValidationError::FailedToOpen;
     }
 
-    // Pad the rom to the nearest multiple of 4 bytes.
-    rom_data.resize((rom_data.size() + 3) & ~3);
+    // Determine the byte order from the first bytes of the ROM before starting the pipeline.
+    std::array<uint8_t, 4> rom_start{};
+    rom_file.read(reinterpret_cast<char*>(rom_start.data()), std::min(rom_start.size(), rom_size));
+    rom_file.seekg(0, std::ios::beg);
 
-    ByteswapType byteswap_type = check_rom_start(rom_data);
+    ByteswapType byteswap_type = check_rom_start(std::span{ rom_start.data(), std::min(rom_start.size(), rom_size) });
+    if (byteswap_type == ByteswapType::Invalid) {
+        return recomp::RomValidationError::NotARom;
+    }
 
-    switch (byteswap_type) {
-        case ByteswapType::Invalid:
-            return recomp::RomValidationError::NotARom;
-        case ByteswapType::Byteswapped2:
-            byteswap_data(rom_data, 1);
-            break;
-        case ByteswapType::Byteswapped4:
-            byteswap_data(rom_data, 3);
-            break;
-        case ByteswapType::NotByteswapped:
+    std::filesystem::path stored_rom_path = config_path / game_entry.stored_filename();
+    // Write to a temporary file and move it into place once validated instead of truncating the existing stored ROM,
+    // as other processes may have it memory mapped.
+    std::filesystem::path temp_rom_path{ stored_rom_path };
+    temp_rom_path += ".temp";
+
+    std::unique_ptr<RomImportPipeline> pipeline = std::make_unique<RomImportPipeline>();
+    for (RomImportChunk& chunk : pipeline->chunks) {
+        chunk.data.resize(rom_import_chunk_size);
+        pipeline->free_chunks.enqueue(&chunk);
+    }
+
+    XXH3_state_t* hash_state = XXH3_createState();
+    XXH3_64bits_reset(hash_state);
+
+    // Chunks are hashed and written in the order they're queued, which is the order they appear in the ROM.
+    // A null chunk signals the end of the ROM.
+    std::thread hash_thread{[&pipeline, hash_state]() {
+        RomImportChunk* chunk;
+        while (true) {
+            pipeline->hash_queue.wait_dequeue(chunk);
+            if (chunk == nullptr) {
+                break;
+            }
+            XXH3_64bits_update(hash_state, chunk->data.data(), chunk->size);
+            pipeline->release_chunk(chunk);
+        }
+    }};
+
+    std::thread write_thread{[&pipeline, &temp_rom_path]() {
+        std::ofstream out_file{ temp_rom_path, std::ios::binary };
+        if (!out_file.good()) {
+            pipeline->write_failed = true;
+        }
+
+        RomImportChunk* chunk;
+        while (true) {
+            pipeline->write_queue.wait_dequeue(chunk);
+            if (chunk == nullptr) {
+                break;
+            }
+            if (!pipeline->write_failed) {
+                out_file.write(reinterpret_cast<const char*>(chunk->data.data()), chunk->size);
+                if (!out_file.good()) {
+                    pipeline->write_failed = true;
+                }
+            }
+            pipeline->release_chunk(chunk);
+        }
+    }};
+
+    // Read and byteswap each chunk on this thread, then hand it off to the hashing and writing threads.
+    std::array<uint8_t, rom_import_header_size> rom_header{};
+    size_t rom_pos = 0;
+    bool read_failed = false;
+    while (rom_pos < rom_size) {
+        RomImportChunk* chunk;
+        pipeline->free_chunks.wait_dequeue(chunk);
+
+        size_t read_size = std::min(rom_import_chunk_size, rom_size - rom_pos);
+        rom_file.read(reinterpret_cast<char*>(chunk->data.data()), read_size);
+        if (!rom_file.good()) {
+            read_failed = true;
             break;
+        }
+
+        // Pad the end of the ROM to the nearest multiple of 4 bytes.
+        chunk->size = (read_size + 3) & ~size_t(3);
+        std::fill(chunk->data.begin() + read_size, chunk->data.begin() + chunk->size, 0);
+        byteswap_data(std::span{ chunk->data.data(), chunk->size }, byteswap_type);
+
+        if (rom_pos == 0) {
+            std::copy_n(chunk->data.begin(), std::min(rom_header.size(), chunk->size), rom_header.begin());
+        }
+
+        rom_pos += read_size;
+
+        chunk->pending_stages = 2;
+        pipeline->hash_queue.enqueue(chunk);
+        pipeline->write_queue.enqueue(chunk);
+    }
+
+    pipeline->hash_queue.enqueue(nullptr);
+    pipeline->write_queue.enqueue(nullptr);
+    hash_thread.join();
+    write_thread.join();
+
+    uint64_t rom_hash = XXH3_64bits_digest(hash_state);
+    XXH3_freeState(hash_state);
+
+    if (read_failed) {
+        std::error_code ec;
+        std::filesystem::remove(temp_rom_path, ec);
+        return recomp::RomValidationError::FailedToOpen;
     }
 
-    if (!check_hash(rom_data, game_entry.rom_hash)) {
-        const std::string_view name{ reinterpret_cast<const char*>(rom_data.data()) + 0x20, game_entry.internal_name.size()};
-        if (name == game_entry.internal_name) {
+    if (rom_hash != game_entry.rom_hash) {
+        std::error_code ec;
+        std::filesystem::remove(temp_rom_path, ec);
+
+        auto header_string = [&](size_t length) {
+            return std::string_view{ reinterpret_cast<const char*>(rom_header.data()) + 0x20, std::min(length, rom_header.size() - 0x20) };
+        };
+        if (header_string(game_entry.internal_name.size()) == game_entry.internal_name) {
             return recomp::RomValidationError::IncorrectVersion;
         }
         else {
-            if (game_entry.is_enabled && std::string_view{ reinterpret_cast<const char*>(rom_data.data()) + 0x20, 19 } == game_entry.internal_name) {
+            if (game_entry.is_enabled && header_string(19) == game_entry.internal_name) {
                 return recomp::RomValidationError::NotYet;
             }
             else {
@@ -393,7 +701,22 @@ recomp::RomValidationError recomp::select_rom(const std::filesystem::path& rom_p
         }
     }
 
-    write_file(config_path / game_entry.stored_filename(), rom_data);
+    std::error_code ec;
+    if (!pipeline->write_failed) {
+        std::filesystem::rename(temp_rom_path, stored_rom_path, ec);
+    }
+
+    if (pipeline->write_failed || ec) {
+        std::filesystem::remove(temp_rom_path, ec);
+    }
+    else {
+        // The ROM was just validated, so record it in the hash cache to skip validating it again on the next launch.
+        recomp::FileIdentity identity;
+        if (recomp::get_file_identity(stored_rom_path, identity)) {
+            cache_rom_hash(game_entry, identity);
+            save_rom_hash_cache();
+        }
+    }
     
     return recomp::RomValidationError::Good;
 }
@@ -538,6 +861,7 @@ moodycamel::LightweightSemaphore graphics_shutdown_ready;
 
 void ultramodern::quit() {
     exited.store(true);
+    ultramodern::wake_threads_for_exit();
     GameStatus desired = GameStatus::None;
     game_status.compare_exchange_strong(desired, GameStatus::Quit);
     game_status.notify_all();
@@ -689,6 +1013,7 @@ bool wait_for_game_started(uint8_t* rdram, recomp_context* context) {
 
                 save_type = game_entry.save_type;
                 ultramodern::init_saving(rdram);
+                recomp::init_pi_dma();
 
                 try {
                     game_entry.entrypoint(rdram, context);
@@ -738,6 +1063,7 @@ void recomp::start(const recomp::Configuration& cfg) {
     static const ultramodern::rsp::callbacks_t ultramodern_rsp_callbacks {
         .init = recomp::rsp::constants_init,
         .run_task = recomp::rsp::run_task,
+        .run_executor_task = recomp::rsp::run_executor_task,
     };
 
     ultramodern::set_callbacks(ultramodern_rsp_callbacks, cfg.renderer_callbacks, cfg.audio_callbacks, cfg.input_callbacks, cfg.gfx_callbacks, cfg.events_callbacks, cfg.error_handling_callbacks, cfg.threads_callbacks);
@@ -761,6 +1087,12 @@ void recomp::start(const recomp::Configuration& cfg) {
     }
 
     ultramodern::set_message_queue_control(cfg.message_queue_control);
+    recomp::set_pi_dma_control(cfg.pi_dma_control);
+    ultramodern::set_pacing_control(cfg.pacing_control);
+    ultramodern::set_thread_scheduling_control(cfg.thread_scheduling_control);
+    ultramodern::set_gfx_queue_control(cfg.gfx_queue_control);
+    ultramodern::set_rsp_task_control(cfg.rsp_task_control);
+    ultramodern::set_vi_catch_up_control(cfg.vi_catch_up_control);
 
     recomp::mods::initialize_mods();
     recomp::mods::scan_mods();
@@ -814,8 +1146,11 @@ void recomp::start(const recomp::Configuration& cfg) {
         while (!wait_for_game_started(rdram, &context)) {}
     }, window_handle, rdram};
 
+    // Run the gfx update on each VI, or sooner if the host requests it with `ultramodern::request_host_update`. The host's
+    // update interval bounds the latency of window and input events for hosts that don't request updates themselves.
     while (!exited) {
-        ultramodern::sleep_milliseconds(1);
+        ultramodern::wait_for_host_update(gfx_callbacks.max_update_interval);
+        ultramodern::report_thread_wakeup();
         if (gfx_callbacks.update_gfx != nullptr) {
             gfx_callbacks.update_gfx(gfx_data);
         }
@@ -826,6 +1161,7 @@ void recomp::start(const recomp::Configuration& cfg) {
     game_thread.join();
     ultramodern::join_event_threads();
     ultramodern::join_thread_cleaner_thread();
+    recomp::join_pi_dma_thread();
     ultramodern::join_saving_thread();
     
     // Free rdram.
@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstring>
 #include <cinttypes>
+#include <mutex>
 
 #include "rsp.hpp"
 
@@ -32,6 +33,28 @@ void recomp::rsp::constants_init() {
     }
 }
 
+// Loads the task into the given DMEM and runs the given recompiled RSP microcode.
+template <typename RunUcode>
+static bool run_ucode(uint8_t* rdram, const OSTask* task, uint8_t* dmem, RunUcode&& run_ucode_func) {
+    // Load the OSTask into DMEM
+    memcpy(&dmem[0xFC0], task, sizeof(OSTask));
+
+    // Load the ucode data into DMEM
+    dma_rdram_to_dmem(rdram, dmem, 0x0000, task->t.ucode_data, 0xF80 - 1);
+
+    // Run the ucode
+    RspExitReason exit_reason = run_ucode_func();
+
+    // Ensure that the ucode exited correctly
+    if (exit_reason != RspExitReason::Broke) {
+        fprintf(stderr, "RSP ucode %" PRIu32 " exited unexpectedly. exit_reason: %i\n", task->t.type, static_cast<int>(exit_reason));
+        assert(exit_reason == RspExitReason::Broke);
+        return false;
+    }
+
+    return true;
+}
+
 // Runs a recompiled RSP microcode
 bool recomp::rsp::run_task(uint8_t* rdram, const OSTask* task) {
     assert(rsp_callbacks.get_rsp_microcode != nullptr);
@@ -42,21 +65,25 @@ bool recomp::rsp::run_task(uint8_t* rdram, const OSTask* task) {
         return false;
     }
 
-    // Load the OSTask into DMEM
-    memcpy(&dmem[0xFC0], task, sizeof(OSTask));
+    return run_ucode(rdram, task, dmem, [&]() { return ucode_func(rdram, task->t.ucode); });
+}
 
-    // Load the ucode data into DMEM
-    dma_rdram_to_dmem(rdram, 0x0000, task->t.ucode_data, 0xF80 - 1);
+// Microcode that uses the global DMEM can only run on one executor at a time.
+static std::mutex global_dmem_mutex;
 
-    // Run the ucode
-    RspExitReason exit_reason = ucode_func(rdram, task->t.ucode);
+// Runs a recompiled RSP microcode on an RSP task executor, using the executor's DMEM if the microcode supports it.
+bool recomp::rsp::run_executor_task(uint8_t* rdram, const OSTask* task, ultramodern::rsp::ExecutorContext* executor) {
+    if (rsp_callbacks.get_rsp_microcode_dmem == nullptr) {
+        std::lock_guard lock{ global_dmem_mutex };
+        return run_task(rdram, task);
+    }
 
-    // Ensure that the ucode exited correctly
-    if (exit_reason != RspExitReason::Broke) {
-        fprintf(stderr, "RSP ucode %" PRIu32 " exited unexpectedly. exit_reason: %i\n", task->t.type, static_cast<int>(exit_reason));
-        assert(exit_reason == RspExitReason::Broke);
+    RspUcodeDmemFunc* ucode_func = rsp_callbacks.get_rsp_microcode_dmem(task);
+
+    if (ucode_func == nullptr) {
+        fprintf(stderr, "No registered RSP ucode for %" PRIu32 " (returned `nullptr`)\n", task->t.type);
         return false;
     }
 
-    return true;
+    return run_ucode(rdram, task, executor->dmem, [&]() { return ucode_func(rdram, task->t.ucode, executor->dmem); });
 }
@@ -42,11 +42,11 @@ extern "C" void osViSetMode_recomp(uint8_t* rdram, recomp_context* ctx) {
     osViSetMode(rdram, (int32_t)ctx->r4);
 }
 
-extern uint64_t total_vis;
+extern std::atomic_uint64_t total_vis;
 
 extern "C" void wait_one_frame(uint8_t* rdram, recomp_context* ctx) {
-    uint64_t cur_vis = total_vis;
-    while (cur_vis == total_vis) {
+    uint64_t cur_vis = total_vis.load(std::memory_order_relaxed);
+    while (cur_vis == total_vis.load(std::memory_order_relaxed)) {
         std::this_thread::yield();
     }
 }
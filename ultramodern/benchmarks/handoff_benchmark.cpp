@@ -0,0 +1,60 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "blockingconcurrentqueue.h"
+
+#include "ultramodern/thread_baton.hpp"
+
+// Measures how long it takes to hand execution back and forth between two host threads, the way game threads hand off to
+// each other, with a ThreadBaton and with the LightweightSemaphore that it replaced.
+//
+// Usage: handoff_benchmark [round trips] [max baton spin in ns]
+
+template <typename Primitive>
+static double run_ping_pong(uint32_t round_trips) {
+    Primitive ping{};
+    Primitive pong{};
+
+    std::thread responder{[&]() {
+        for (uint32_t i = 0; i < round_trips; i++) {
+            ping.wait();
+            pong.signal();
+        }
+    }};
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < round_trips; i++) {
+        ping.signal();
+        pong.wait();
+    }
+    auto duration = std::chrono::steady_clock::now() - start;
+    responder.join();
+
+    // Each round trip is two handoffs.
+    return std::chrono::duration<double, std::nano>(duration).count() / (2.0 * round_trips);
+}
+
+int main(int argc, char** argv) {
+    uint32_t round_trips = argc > 1 ? atoi(argv[1]) : 100000;
+    if (round_trips == 0) {
+        fprintf(stderr, "Usage: %s [round trips] [max baton spin in ns]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (argc > 2) {
+        ultramodern::set_thread_baton_max_spin(std::chrono::nanoseconds{ atoll(argv[2]) });
+    }
+
+    double semaphore_ns = run_ping_pong<moodycamel::LightweightSemaphore>(round_trips);
+    printf("LightweightSemaphore: %10.1f ns per handoff\n", semaphore_ns);
+
+    double baton_ns = run_ping_pong<ultramodern::ThreadBaton>(round_trips);
+    ultramodern::ThreadBatonStats stats = ultramodern::get_thread_baton_stats();
+    printf("ThreadBaton:          %10.1f ns per handoff\n", baton_ns);
+    printf("  spin hits %llu, spin misses %llu, wake latency %lld ns, spin window %lld ns\n",
+        (unsigned long long)stats.spin_hits, (unsigned long long)stats.spin_misses,
+        (long long)stats.wake_latency.count(), (long long)stats.spin_window.count());
+
+    return EXIT_SUCCESS;
+}
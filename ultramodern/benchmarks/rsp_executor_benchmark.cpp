@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "ultramodern/ultra64.h"
+#include "ultramodern/ultramodern.hpp"
+#include "ultramodern/null_renderer.hpp"
+
+// Measures the throughput of non-graphics RSP tasks through the runtime's task queue and executor pool, including the
+// completion messages that the game receives. Each task runs a synthetic microcode that does a fixed amount of work on
+// its executor's DMEM.
+//
+// Usage: rsp_executor_benchmark [executor count] [task count] [passes over DMEM per task]
+
+// Defined in scheduling.cpp.
+extern "C" void pause_self(RDRAM_ARG1);
+
+// Provided by the host application, which is librecomp outside of this benchmark.
+std::atomic_bool exited = false;
+moodycamel::LightweightSemaphore graphics_shutdown_ready;
+
+// Keeps the VI on its dummy mode, as the benchmark never sets one.
+bool ultramodern::is_game_started() {
+    return false;
+}
+
+constexpr size_t rdram_size = 8 * 1024 * 1024;
+// Number of tasks in flight at once, which is as many as the completion queue can hold.
+constexpr uint32_t batch_size = 16;
+
+constexpr PTR(OSThread) idle_thread = 0x80010000;
+constexpr PTR(OSThread) bench_thread = 0x80010400;
+constexpr PTR(OSMesgQueue) sp_queue = 0x80011000;
+constexpr PTR(OSMesg) sp_queue_buffer = 0x80011100;
+constexpr PTR(OSMesg) received_mesg = 0x80011200;
+constexpr PTR(OSTask) tasks = 0x80012000;
+
+constexpr PTR(void) idle_thread_entry = 1;
+constexpr PTR(void) bench_thread_entry = 2;
+
+static uint32_t executor_count = 1;
+static uint32_t task_count = 2000;
+static uint32_t passes_per_task = 64;
+
+static bool run_benchmark_task(RDRAM_ARG const OSTask* task, ultramodern::rsp::ExecutorContext* executor) {
+    uint8_t* dmem = executor->dmem;
+    uint32_t hash = 2166136261u;
+    for (uint32_t pass = 0; pass < passes_per_task; pass++) {
+        for (size_t i = 0; i < ultramodern::rsp::dmem_size; i++) {
+            hash = (hash ^ dmem[i]) * 16777619u;
+            dmem[i] = uint8_t(hash);
+        }
+    }
+    return true;
+}
+
+static bool run_benchmark_task_without_executor(RDRAM_ARG const OSTask* task) {
+    static ultramodern::rsp::ExecutorContext executor{};
+    return run_benchmark_task(PASS_RDRAM task, &executor);
+}
+
+static std::unique_ptr<ultramodern::renderer::RendererContext> create_null_renderer(uint8_t* rdram, ultramodern::renderer::WindowHandle window_handle, bool developer_mode) {
+    return std::make_unique<ultramodern::renderer::NullRendererContext>(rdram, ultramodern::renderer::NullRendererConfig{});
+}
+
+static void run_bench_thread(RDRAM_ARG1) {
+    osCreateMesgQueue(PASS_RDRAM sp_queue, sp_queue_buffer, batch_size);
+    osSetEventMesg(PASS_RDRAM OS_EVENT_SP, sp_queue, NULLPTR);
+
+    for (uint32_t i = 0; i < batch_size; i++) {
+        OSTask* task = TO_PTR(OSTask, tasks + i * sizeof(OSTask));
+        task->t.type = M_NJPEGTASK;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    uint32_t submitted = 0;
+    while (submitted < task_count) {
+        uint32_t batch = std::min(batch_size, task_count - submitted);
+        for (uint32_t i = 0; i < batch; i++) {
+            ultramodern::submit_rsp_task(PASS_RDRAM tasks + i * sizeof(OSTask));
+        }
+        for (uint32_t i = 0; i < batch; i++) {
+            osRecvMesg(PASS_RDRAM sp_queue, received_mesg, OS_MESG_BLOCK);
+        }
+        submitted += batch;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printf("%u tasks of %u DMEM passes on %u executors: %.3f s, %.0f tasks/s, %.1f us per task\n",
+        task_count, passes_per_task, executor_count, seconds,
+        task_count / seconds, seconds * 1e6 / task_count);
+    fflush(stdout);
+    // The runtime's threads aren't set up to be joined without a host, so exit immediately.
+    std::quick_exit(EXIT_SUCCESS);
+}
+
+void run_thread_function(uint8_t* rdram, uint64_t addr, uint64_t sp, uint64_t arg) {
+    switch (static_cast<PTR(void)>(addr)) {
+        case idle_thread_entry:
+            osStartThread(PASS_RDRAM bench_thread);
+            pause_self(PASS_RDRAM1);
+            break;
+        case bench_thread_entry:
+            run_bench_thread(PASS_RDRAM1);
+            break;
+    }
+}
+
+int main(int argc, char** argv) {
+    executor_count = argc > 1 ? atoi(argv[1]) : executor_count;
+    task_count = argc > 2 ? atoi(argv[2]) : task_count;
+    passes_per_task = argc > 3 ? atoi(argv[3]) : passes_per_task;
+    if (executor_count == 0 || task_count == 0) {
+        fprintf(stderr, "Usage: %s [executor count] [task count] [passes over DMEM per task]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    ultramodern::rsp::callbacks_t rsp_callbacks{
+        .init = nullptr,
+        .run_task = run_benchmark_task_without_executor,
+        .run_executor_task = run_benchmark_task,
+    };
+    ultramodern::renderer::callbacks_t renderer_callbacks{
+        .create_render_context = create_null_renderer,
+    };
+    ultramodern::set_callbacks(rsp_callbacks, renderer_callbacks, {}, {}, {}, {}, {}, {});
+
+    ultramodern::RspTaskControl rsp_task_control{};
+    rsp_task_control.executor_count = executor_count;
+    ultramodern::set_rsp_task_control(rsp_task_control);
+
+    std::vector<uint8_t> rdram(rdram_size);
+    ultramodern::preinit(rdram.data(), {});
+
+    osCreateThread(rdram.data(), idle_thread, 1, idle_thread_entry, NULLPTR, 0x80100000, 0);
+    osCreateThread(rdram.data(), bench_thread, 2, bench_thread_entry, NULLPTR, 0x80140000, 10);
+    osStartThread(rdram.data(), idle_thread);
+
+    // The benchmark thread exits the process once it's done.
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds{ 1 });
+    }
+}
@@ -1,11 +1,14 @@
 #ifndef __EVENTS_HPP__
 #define __EVENTS_HPP__
 
+#include <cstdint>
+
 namespace ultramodern {
     namespace events {
         struct callbacks_t {
             using vi_callback_t = void();
             using gfx_init_callback_t = void();
+            using vi_late_callback_t = void(uint64_t missed_vis);
 
             /**
              * Called in each VI.
@@ -16,6 +19,12 @@ namespace ultramodern {
              * Called before entering the gfx main loop.
              */
             gfx_init_callback_t* gfx_init_callback;
+
+            /**
+             * Called on the VI thread when a VI tick wakes up late enough that VIs were missed, before the catch-up policy
+             * delivers them. This callback is optional.
+             */
+            vi_late_callback_t* vi_late_callback = nullptr;
         };
 
         void set_callbacks(const callbacks_t& callbacks);
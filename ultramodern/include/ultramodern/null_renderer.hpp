@@ -0,0 +1,95 @@
+#ifndef __NULL_RENDERER_HPP__
+#define __NULL_RENDERER_HPP__
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "renderer_context.hpp"
+
+namespace ultramodern {
+    namespace renderer {
+        // Command encoding of the display lists that the null renderer walks.
+        enum class DisplayListFormat {
+            F3D,
+            F3DEX2
+        };
+
+        struct NullRendererFrame {
+            uint64_t frame_index = 0;
+            // Hash of the bytes of every display list command walked during the frame, or 0 if hashing is disabled.
+            uint64_t dl_hash = 0;
+            uint32_t dl_count = 0;
+            uint32_t command_count = 0;
+            // Number of display lists in the frame that failed validation.
+            uint32_t invalid_dl_count = 0;
+            // Time spent walking display lists during the frame.
+            std::chrono::nanoseconds dl_time{};
+            // Host time between this frame's screen update and the previous one.
+            std::chrono::nanoseconds frame_time{};
+        };
+
+        struct NullRendererStats {
+            uint64_t frame_count = 0;
+            uint64_t dl_count = 0;
+            uint64_t command_count = 0;
+            uint64_t invalid_dl_count = 0;
+            std::chrono::nanoseconds total_dl_time{};
+            std::chrono::nanoseconds max_frame_time{};
+            NullRendererFrame last_frame{};
+        };
+
+        struct NullRendererConfig {
+            DisplayListFormat format = DisplayListFormat::F3DEX2;
+            // Hash each frame's display list bytes so that runs can be checked for determinism.
+            bool hash_frames = false;
+            // Print a warning for each display list that fails validation.
+            bool log_invalid_dls = true;
+            // Called on the graphics thread on each screen update with the frame that was just completed.
+            std::function<void(const NullRendererFrame&)> frame_callback;
+        };
+
+        /**
+         * A renderer that doesn't draw anything, for running games without a GPU (e.g. for benchmarking the runtime).
+         * Submitted display lists are walked through their calls and branches and validated against RDRAM, and screen
+         * updates complete immediately so the VI thread alone paces the game.
+         */
+        class NullRendererContext : public RendererContext {
+            public:
+                NullRendererContext(uint8_t* rdram, const NullRendererConfig& config);
+                ~NullRendererContext() override;
+
+                bool valid() override { return true; }
+
+                bool update_config(const GraphicsConfig& old_config, const GraphicsConfig& new_config) override { return true; }
+
+                void enable_instant_present() override {}
+                void send_dl(const OSTask* task) override;
+                void update_screen() override;
+                void shutdown() override {}
+                uint32_t get_display_framerate() const override { return 60; }
+                float get_resolution_scale() const override { return 1.0f; }
+
+            private:
+                // Walks the display list at the given address. Returns false if it failed validation.
+                bool walk_display_list(uint32_t address);
+
+                uint8_t* rdram;
+                NullRendererConfig config;
+                std::array<uint32_t, 16> segments{};
+                NullRendererFrame cur_frame{};
+                std::chrono::high_resolution_clock::time_point last_screen_update;
+        };
+
+        // Sets the configuration used by null renderer contexts created after this call.
+        void set_null_renderer_config(const NullRendererConfig& config);
+        // Returns statistics accumulated by null renderer contexts since startup.
+        NullRendererStats get_null_renderer_stats();
+        // Matches `callbacks_t::create_render_context_t` so that it can be registered as the renderer directly.
+        std::unique_ptr<RendererContext> create_null_render_context(uint8_t* rdram, WindowHandle window_handle, bool developer_mode);
+    }
+}
+
+#endif
@@ -7,9 +7,18 @@
 
 namespace ultramodern {
     namespace rsp {
+        constexpr uint32_t dmem_size = 0x1000;
+
+        // State owned by one RSP task executor thread. It persists across every task that runs on that executor.
+        struct ExecutorContext {
+            uint32_t index = 0;
+            uint8_t dmem[dmem_size]{};
+        };
+
         struct callbacks_t {
             using init_t = void();
             using run_microcode_t = bool(RDRAM_ARG const OSTask* task);
+            using run_executor_microcode_t = bool(RDRAM_ARG const OSTask* task, ExecutorContext* executor);
 
             init_t* init;
 
@@ -19,12 +28,20 @@ namespace ultramodern {
              * Returns true if task was executed successfully.
              */
             run_microcode_t* run_task;
+
+            /**
+             * Executes the given RSP task on the given executor, which allows using the executor's DMEM.
+             *
+             * Optional. If provided, this is used instead of `run_task` for tasks run by RSP task executors.
+             */
+            run_executor_microcode_t* run_executor_task;
         };
 
         void set_callbacks(const callbacks_t& callbacks);
 
         void init();
         bool run_task(RDRAM_ARG const OSTask* task);
+        bool run_task(RDRAM_ARG const OSTask* task, ExecutorContext* executor);
     };
 } // namespace ultramodern
 
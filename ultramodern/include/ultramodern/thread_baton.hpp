@@ -0,0 +1,47 @@
+#ifndef __THREAD_BATON_HPP__
+#define __THREAD_BATON_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace ultramodern {
+    /**
+     * Hands execution from one game thread to the next. Each game thread waits on its own baton, and the thread giving up
+     * execution signals the next thread's baton before waiting on its own.
+     *
+     * Waiting spins for a window based on the measured wakeup latency of sleeping waiters before going to sleep on a futex
+     * (WaitOnAddress on Windows), and signalling only makes a wake call if the waiter is actually asleep.
+     */
+    class ThreadBaton {
+        public:
+            void signal();
+            void wait();
+
+        private:
+            bool try_acquire();
+
+            // Number of pending signals, or -1 while the owning thread is asleep waiting for one.
+            std::atomic<int32_t> value{ 0 };
+            // Host time of the last signal that woke a sleeping waiter, used to measure wakeup latency.
+            std::atomic<int64_t> signal_time{ 0 };
+    };
+
+    struct ThreadBatonStats {
+        uint64_t signals;
+        // Waits that were satisfied without sleeping, either immediately or while spinning.
+        uint64_t spin_hits;
+        // Waits that had to sleep until they were woken.
+        uint64_t spin_misses;
+        // Moving average of the time between a signal and the sleeping waiter it woke running again.
+        std::chrono::nanoseconds wake_latency;
+        // How long waits currently spin before sleeping.
+        std::chrono::nanoseconds spin_window;
+    };
+
+    // Sets the upper bound on the spin window. A value of zero disables spinning.
+    void set_thread_baton_max_spin(std::chrono::nanoseconds max_spin);
+    ThreadBatonStats get_thread_baton_stats();
+}
+
+#endif
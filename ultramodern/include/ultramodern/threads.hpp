@@ -1,6 +1,8 @@
 #ifndef __THREADS_HPP__
 #define __THREADS_HPP__
 
+#include <array>
+#include <cstdint>
 #include <string>
 
 #include "ultra64.h"
@@ -23,6 +25,30 @@ namespace ultramodern {
         void set_callbacks(const callbacks_t& callbacks);
 
         std::string get_game_thread_name(const OSThread* t);
+
+        constexpr uint32_t max_game_thread_locals = 8;
+        using game_thread_local_destructor_t = void(void* value);
+
+        // The values of every game thread local slot for one thread, which are destroyed along with it.
+        struct GameThreadLocals {
+            std::array<void*, max_game_thread_locals> values{};
+
+            GameThreadLocals() = default;
+            GameThreadLocals(const GameThreadLocals&) = delete;
+            GameThreadLocals& operator=(const GameThreadLocals&) = delete;
+            ~GameThreadLocals();
+        };
+
+        /**
+         * Reserves a pointer slot in every game thread for state that game code keeps per thread, returning the slot's index.
+         *
+         * Unlike thread_local variables, a slot follows its game thread when game threads run as user-space contexts on a shared
+         * host thread. Slots start out null and the destructor is called on each non-null value when its thread is deleted.
+         * Threads that aren't an OSThread, such as the entrypoint thread, get slots that are destroyed when the host thread exits.
+         */
+        uint32_t reserve_game_thread_local(game_thread_local_destructor_t* destructor);
+        void* get_game_thread_local(uint32_t slot);
+        void set_game_thread_local(uint32_t slot, void* value);
     }
 }
 
@@ -7,6 +7,11 @@
 #include <span>
 #include <chrono>
 #include <filesystem>
+#include <array>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #undef MOODYCAMEL_DELETE_FUNCTION
 #define MOODYCAMEL_DELETE_FUNCTION = delete
@@ -19,12 +24,18 @@
 #include "ultramodern/input.hpp"
 #include "ultramodern/renderer_context.hpp"
 #include "ultramodern/rsp.hpp"
+#include "ultramodern/thread_baton.hpp"
 #include "ultramodern/threads.hpp"
 
+struct UltraUserContext;
+
 struct UltraThreadContext {
     std::thread host_thread;
-    moodycamel::LightweightSemaphore running;
+    ultramodern::ThreadBaton running;
     moodycamel::LightweightSemaphore initialized;
+    // Only set when game threads run as user-space contexts, in which case the host thread and semaphores are unused.
+    UltraUserContext* user_context = nullptr;
+    ultramodern::threads::GameThreadLocals locals;
 };
 
 namespace ultramodern {
@@ -70,8 +81,34 @@ struct MessageQueueControl {
     bool requeue_vi = false;
     bool requeue_pi = false;
     bool requeue_dp = true;
+    // Collect per-queue statistics, which can be read with `get_message_queue_stats`.
+    bool collect_stats = false;
 };
 void set_message_queue_control(const MessageQueueControl& mqc);
+
+struct MessageQueueStats {
+    uint64_t sends;
+    uint64_t jams;
+    uint64_t receives;
+    // Messages from non-game threads that were delivered to the queue, and that were dropped because it was full.
+    uint64_t external_deliveries;
+    uint64_t external_drops;
+    // Number of delivery attempts that left an external message pending because the queue was full.
+    uint64_t requeues;
+    // Time between a non-game thread sending a message and its delivery to the queue.
+    std::chrono::nanoseconds total_delivery_latency;
+    std::chrono::nanoseconds max_delivery_latency;
+    // Number of times, and total time, game threads were blocked sending to a full queue or receiving from an empty one.
+    uint64_t full_blocks;
+    uint64_t empty_blocks;
+    std::chrono::nanoseconds full_blocked_time;
+    std::chrono::nanoseconds empty_blocked_time;
+    // Largest number of messages the queue has held.
+    int32_t max_depth;
+};
+// Returns the statistics of every queue that has been used since stats collection was enabled, keyed by RDRAM address.
+std::unordered_map<PTR(OSMesgQueue), MessageQueueStats> get_message_queue_stats();
+void reset_message_queue_stats();
 void enqueue_external_message_src(PTR(OSMesgQueue) mq, OSMesg msg, bool jam, EventMessageSource src);
 void enqueue_external_message(PTR(OSMesgQueue) mq, OSMesg msg, bool jam, bool requeue_if_blocked);
 void wait_for_external_message(RDRAM_ARG1);
@@ -93,24 +130,190 @@ enum class ThreadPriority {
     Critical
 };
 
+struct ThreadSchedulingControl {
+    // Threads at or above this priority use a realtime scheduling policy when the process is permitted to (Linux).
+    // Threads below it, or all threads if realtime scheduling isn't permitted, use nice values instead.
+    ThreadPriority realtime_threshold = ThreadPriority::VeryHigh;
+    bool allow_realtime = true;
+    // CPUs to pin runtime threads to, keyed by native thread name (e.g. "VI Thread", "Gfx Thread", "SP Task Thread",
+    // "Timer Thread", "Saving Thread", "Game Threads"). Threads that aren't listed can run on any CPU. Not supported on macOS.
+    std::unordered_map<std::string, std::vector<uint32_t>> cpu_affinity;
+    // Run every game thread as a user-space context on a single host thread ("Game Threads") instead of giving each one
+    // its own host thread, which turns libultra thread switches into direct context swaps. Only supported on Linux and
+    // Windows, and only read when the first game thread is created.
+    bool user_space_game_threads = false;
+    // Stack size reserved for each game thread's context in user-space mode.
+    size_t game_thread_stack_size = 8 * 1024 * 1024;
+    // Upper bound on how long a game thread spins waiting for execution to be handed to it before sleeping. The actual
+    // spin window follows the measured wakeup latency of sleeping threads. A value of zero disables spinning.
+    std::chrono::nanoseconds max_handoff_spin{ 20000 };
+};
+void set_thread_scheduling_control(const ThreadSchedulingControl& control);
+
+// Sets the calling thread's name, and pins it to the CPUs configured for that name if any.
 void set_native_thread_name(const std::string& name);
 void set_native_thread_priority(ThreadPriority pri);
+// Counts a wakeup of one of the runtime's service threads, which allows measuring how often the runtime wakes up when idle.
+void report_thread_wakeup();
+uint64_t get_thread_wakeup_count();
+// Returns the average number of service thread wakeups per second since the previous call.
+double get_thread_wakeups_per_second();
 PTR(OSThread) this_thread();
 void set_entrypoint_thread();
 bool is_entrypoint_thread();
 bool is_game_thread();
 void submit_rsp_task(RDRAM_ARG PTR(OSTask) task);
+
+struct RspTaskControl {
+    // Number of threads that run non-graphics RSP tasks. Independent tasks can run concurrently when this is above 1, but
+    // their completion messages are still sent in submission order. Each executor has its own DMEM, which only persists
+    // across the tasks that run on that executor, so only raise this for microcode that doesn't rely on DMEM contents
+    // from previous tasks. Takes effect when the runtime starts.
+    uint32_t executor_count = 1;
+    // Scheduling priority of each task type, where higher runs first. Unlisted types have a priority of 0.
+    // Tasks with the same priority run in order of their deadlines.
+    std::unordered_map<uint32_t, int32_t> task_priorities{ { M_AUDTASK, 1 } };
+};
+void set_rsp_task_control(const RspTaskControl& control);
+
+// Statistics for one RSP task type. Audio tasks are due when the audio backend's buffer would run dry and other tasks
+// are due at the next VI.
+struct RspTaskTypeStats {
+    uint64_t completed;
+    uint64_t deadlines_missed;
+    // Total time tasks spent queued before an executor picked them up.
+    std::chrono::nanoseconds total_wait_time;
+    // Largest amount of time by which a task finished after its deadline.
+    std::chrono::nanoseconds max_lateness;
+};
+std::unordered_map<uint32_t, RspTaskTypeStats> get_rsp_task_stats();
 void send_si_message();
-uint32_t get_speed_multiplier();
 
 // Time
 std::chrono::high_resolution_clock::time_point get_start();
 std::chrono::high_resolution_clock::duration time_since_start();
+
+// Rate at which emulated time (the VI schedule, osGetCount, osGetTime and OSTimer deadlines) advances relative to the host clock.
+struct SpeedFactor {
+    uint32_t numerator = 1;
+    uint32_t denominator = 1;
+    // Runs the VI as fast as the renderer accepts frames instead of at the rate above. Emulated time advances by one VI period
+    // for each VI and never more slowly than the host clock.
+    bool uncapped = false;
+};
+// Changes the speed factor at runtime. Emulated time stays continuous across the change.
+void set_speed_factor(const SpeedFactor& factor);
+SpeedFactor get_speed_factor();
+std::chrono::nanoseconds emulated_time_since_start();
+// Returns the host time at which the given emulated time will be reached at the current speed factor.
+std::chrono::high_resolution_clock::time_point emulated_to_host_time(std::chrono::nanoseconds emulated_time);
+// Moves emulated time forward to the given time if it's behind it. Used by the VI thread in uncapped mode.
+void advance_emulated_time(std::chrono::nanoseconds emulated_time);
 void measure_input_latency();
+// Blocks the host's main loop until the next VI, a call to `request_host_update` or shutdown, waiting no longer than the given timeout.
+// A zero timeout waits without a limit.
+void wait_for_host_update(std::chrono::microseconds timeout);
+// Wakes the host's main loop early, e.g. from a window or input event watcher so that events are handled without waiting for the next VI.
+void request_host_update();
 void sleep_milliseconds(uint32_t millis);
+// Sleeps until the given time point. The thread sleeps until shortly before the deadline and then spins for the remainder,
+// as configured by `PacingControl`, to avoid the wakeup latency of the OS scheduler.
 void sleep_until(const std::chrono::high_resolution_clock::time_point& time_point);
 
+struct PacingControl {
+    // Upper bound on how long before a deadline to stop sleeping and start spinning. The window actually used follows the
+    // measured oversleep of each thread. Zero disables spinning, which avoids the extra CPU use at the cost of some lateness.
+    std::chrono::microseconds spin_window{ 0 };
+    // Reduce the OS timer slack of threads that wait for deadlines, where supported (Linux).
+    bool reduce_timer_slack = true;
+};
+void set_pacing_control(const PacingControl& control);
+
+// Histogram of how late each VI tick was relative to its scheduled time.
+struct ViPacingStats {
+    // Upper bound in microseconds of each bucket's lateness, with the last bucket containing anything later.
+    static constexpr std::array<uint32_t, 9> bucket_limits_us{ 10, 25, 50, 100, 250, 500, 1000, 2000, 4000 };
+    std::array<uint64_t, bucket_limits_us.size() + 1> buckets;
+    uint64_t tick_count;
+    std::chrono::nanoseconds total_lateness;
+    std::chrono::nanoseconds max_lateness;
+};
+ViPacingStats get_vi_pacing_stats();
+void reset_vi_pacing_stats();
+
+// How the VI thread handles VIs that were missed because it woke up late.
+enum class ViCatchUpPolicy {
+    // Drop the missed VIs and continue from the current one.
+    SkipToPresent,
+    // Deliver every missed VI immediately along with the current one.
+    Burst,
+    // Deliver the missed VIs a few at a time over the following `spread_vis` VIs.
+    Spread
+};
+struct ViCatchUpControl {
+    ViCatchUpPolicy policy = ViCatchUpPolicy::SkipToPresent;
+    uint32_t spread_vis = 4;
+    // Missed VIs beyond this many are skipped even under Burst and Spread, to avoid a flood of interrupts after a long stall.
+    uint32_t max_catch_up_vis = 30;
+};
+void set_vi_catch_up_control(const ViCatchUpControl& control);
+
+struct ViCatchUpStats {
+    // VI ticks that woke after one or more later VIs were already due.
+    uint64_t late_ticks;
+    uint64_t missed_vis;
+    // Missed VIs that were dropped and never delivered.
+    uint64_t skipped_vis;
+    // Missed VIs that were delivered late.
+    uint64_t caught_up_vis;
+};
+ViCatchUpStats get_vi_catch_up_stats();
+
 // Graphics
+// Limits on how far the game and VI can get ahead of the renderer. Superseded screen updates are always coalesced.
+struct GfxQueueControl {
+    // Number of display lists waiting for the graphics thread at which submitting another blocks the game until the
+    // renderer catches up. Zero means unbounded.
+    uint32_t max_pending_display_lists = 0;
+    // Screen updates that have waited longer than this when the graphics thread reaches them are dropped instead of
+    // presented. Zero means screen updates are never dropped.
+    std::chrono::microseconds max_screen_update_age{ 0 };
+};
+void set_gfx_queue_control(const GfxQueueControl& control);
+
+struct GfxQueueStats {
+    uint64_t display_lists;
+    uint64_t screen_updates_presented;
+    // Screen updates replaced by a newer one before the graphics thread reached them.
+    uint64_t screen_updates_coalesced;
+    // Screen updates discarded for exceeding the age budget.
+    uint64_t screen_updates_dropped;
+    // Number of times, and total time, the game was blocked by the display list budget.
+    uint64_t display_list_blocks;
+    std::chrono::nanoseconds display_list_block_time;
+};
+GfxQueueStats get_gfx_queue_stats();
+
+// Timestamps of one frame's trip through the graphics pipeline, where a frame is one graphics task submitted by the game.
+// Times that weren't reached (e.g. the screen update for a frame that was never presented) are left at the clock's epoch.
+struct FrameTimeline {
+    uint64_t frame_id;
+    // The most recent VI tick before the game submitted the frame.
+    std::chrono::high_resolution_clock::time_point vi_time;
+    std::chrono::high_resolution_clock::time_point submit_time;
+    std::chrono::high_resolution_clock::time_point renderer_start_time;
+    std::chrono::high_resolution_clock::time_point renderer_end_time;
+    std::chrono::high_resolution_clock::time_point dp_complete_time;
+    // The screen update that first presented the frame.
+    std::chrono::high_resolution_clock::time_point screen_update_start_time;
+    std::chrono::high_resolution_clock::time_point screen_update_end_time;
+};
+// Number of most recent frame timelines that are kept.
+constexpr size_t frame_timeline_capacity = 256;
+// Returns the kept frame timelines with an ID greater than the given one, oldest first. Passing the ID of the last
+// timeline returned by a previous call allows reading the timeline incrementally.
+std::vector<FrameTimeline> get_frame_timelines(uint64_t after_frame_id = 0);
+
 uint32_t get_target_framerate(uint32_t original);
 uint32_t get_display_refresh_rate();
 float get_resolution_scale();
@@ -121,6 +324,8 @@ void init_audio();
 void set_audio_frequency(uint32_t freq);
 void queue_audio_buffer(RDRAM_ARG PTR(s16) audio_data, uint32_t byte_count);
 uint32_t get_remaining_audio_bytes();
+// Returns how long the audio currently queued in the audio backend will take to play, if the backend reports it.
+std::optional<std::chrono::microseconds> get_buffered_audio_duration();
 
 struct audio_callbacks_t {
     using queue_samples_t = void(int16_t*, size_t);
@@ -141,10 +346,15 @@ struct gfx_callbacks_t {
     create_gfx_t* create_gfx;
     create_window_t* create_window;
     update_gfx_t* update_gfx;
+    // Longest time the host's main loop waits between calls to `update_gfx`. Hosts that call `request_host_update` from a
+    // window or input event watcher can set this to zero so that the loop only wakes for VIs and events.
+    std::chrono::microseconds max_update_interval{ 4000 };
 };
 
 bool is_game_started();
 void quit();
+// Wakes the event threads and the host's main loop so they can observe that the runtime is exiting.
+void wake_threads_for_exit();
 void join_event_threads();
 void join_thread_cleaner_thread();
 void join_saving_thread();
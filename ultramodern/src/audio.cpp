@@ -1,6 +1,7 @@
 #include "ultramodern/ultra64.h"
 #include "ultramodern/ultramodern.hpp"
 #include <cassert>
+#include <optional>
 
 static uint32_t sample_rate = 48000;
 
@@ -35,6 +36,13 @@ void ultramodern::queue_audio_buffer(RDRAM_ARG PTR(int16_t) audio_data_, uint32_
     }
 }
 
+std::optional<std::chrono::microseconds> ultramodern::get_buffered_audio_duration() {
+    if (audio_callbacks.get_frames_remaining == nullptr || sample_rate == 0) {
+        return std::nullopt;
+    }
+    return std::chrono::microseconds{ uint64_t(audio_callbacks.get_frames_remaining()) * 1'000'000 / sample_rate };
+}
+
 // For SDL2
 //uint32_t buffer_offset_frames = 1;
 // For Godot
@@ -7,7 +7,13 @@
 #include <utility>
 #include <mutex>
 #include <queue>
+#include <deque>
+#include <optional>
+#include <condition_variable>
 #include <cstring>
+#include <algorithm>
+#include <set>
+#include <vector>
 
 #include "blockingconcurrentqueue.h"
 
@@ -26,16 +32,46 @@ void ultramodern::events::set_callbacks(const ultramodern::events::callbacks_t&
 
 struct SpTaskAction {
     OSTask task;
+    uint64_t sequence;
+    // Timeline record for the frame this display list belongs to, with the times known at submission filled in.
+    ultramodern::FrameTimeline timeline;
 };
 
 struct ScreenUpdateAction {
     ultramodern::renderer::ViRegs regs;
+    uint64_t sequence;
+    std::chrono::high_resolution_clock::time_point sent_time;
 };
 
 struct UpdateConfigAction {
 };
 
-using Action = std::variant<SpTaskAction, ScreenUpdateAction, UpdateConfigAction>;
+// Wakes the graphics thread so it can observe that the runtime is exiting.
+struct ShutdownAction {
+};
+
+using Action = std::variant<SpTaskAction, ScreenUpdateAction, UpdateConfigAction, ShutdownAction>;
+
+struct SpTaskRequest {
+    OSTask* task = nullptr;
+    uint64_t sequence = 0;
+    int32_t priority = 0;
+    std::chrono::high_resolution_clock::time_point submit_time{};
+    std::chrono::high_resolution_clock::time_point deadline{};
+};
+
+// Orders RSP tasks so that the highest priority task with the earliest deadline runs first.
+struct SpTaskRequestCompare {
+    bool operator()(const SpTaskRequest& a, const SpTaskRequest& b) const {
+        if (a.priority != b.priority) {
+            return a.priority < b.priority;
+        }
+        if (a.deadline != b.deadline) {
+            return a.deadline > b.deadline;
+        }
+        return a.sequence > b.sequence;
+    }
+};
 
 struct ViState {
     const OSViMode* mode;
@@ -109,7 +145,7 @@ static struct {
     } vi;
     struct {
         std::thread gfx_thread;
-        std::thread task_thread;
+        std::vector<std::thread> task_threads;
         PTR(OSMesgQueue) mq = NULLPTR;
         OSMesg msg = (OSMesg)0;
     } sp;
@@ -128,8 +164,63 @@ static struct {
     // The same message queue may be used for multiple events, so share a mutex for all of them
     std::mutex message_mutex;
     uint8_t* rdram;
-    moodycamel::BlockingConcurrentQueue<Action> action_queue{};
-    moodycamel::BlockingConcurrentQueue<OSTask*> sp_task_queue{};
+    // Graphics thread actions, kept in a lane per action type so that superseded screen updates can be coalesced.
+    // Sequence numbers preserve the submission order between display lists and screen updates.
+    struct {
+        std::mutex mutex;
+        std::condition_variable action_ready;
+        std::condition_variable display_list_consumed;
+        std::deque<SpTaskAction> display_lists;
+        std::optional<ScreenUpdateAction> screen_update;
+        bool config_update = false;
+        bool shutdown = false;
+        uint64_t next_sequence = 0;
+    } gfx_lanes;
+    // Signaled on each VI and on shutdown to wake the host's main loop.
+    moodycamel::LightweightSemaphore host_update_semaphore{};
+    // Screen updates sent to and completed by the graphics thread, which limits how far ahead the VI can run in uncapped mode.
+    std::atomic_uint64_t screen_updates_sent = 0;
+    std::atomic_uint64_t screen_updates_completed = 0;
+    moodycamel::LightweightSemaphore screen_update_completed_semaphore{};
+    // Host time of the most recent VI tick, as a count of high_resolution_clock ticks.
+    std::atomic<std::chrono::high_resolution_clock::rep> last_vi_time{ 0 };
+    struct {
+        std::mutex mutex;
+        std::array<ultramodern::FrameTimeline, ultramodern::frame_timeline_capacity> records{};
+        uint64_t next_frame_id = 1;
+        // Number of records written to the ring in total.
+        uint64_t write_count = 0;
+    } frame_timelines;
+    std::mutex gfx_queue_control_mutex;
+    ultramodern::GfxQueueControl gfx_queue_control{};
+    struct {
+        std::atomic_uint64_t display_lists = 0;
+        std::atomic_uint64_t screen_updates_presented = 0;
+        std::atomic_uint64_t screen_updates_coalesced = 0;
+        std::atomic_uint64_t screen_updates_dropped = 0;
+        std::atomic_uint64_t display_list_blocks = 0;
+        std::atomic_int64_t display_list_block_time_ns = 0;
+    } gfx_queue_stats;
+    struct {
+        std::mutex mutex;
+        std::condition_variable task_ready;
+        std::priority_queue<SpTaskRequest, std::vector<SpTaskRequest>, SpTaskRequestCompare> tasks;
+        bool shutdown = false;
+    } sp_task_queue;
+    struct {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, ultramodern::RspTaskTypeStats> by_type;
+    } sp_task_stats;
+    // Tasks may finish out of order when several executors are running, so completions are held back until every
+    // earlier task has also finished.
+    struct {
+        std::mutex mutex;
+        uint64_t next_sequence = 0;
+        uint64_t next_completion = 0;
+        std::set<uint64_t> finished;
+    } sp_task_completion;
+    std::mutex rsp_task_control_mutex;
+    ultramodern::RspTaskControl rsp_task_control{};
     moodycamel::ConcurrentQueue<OSThread*> deleted_threads{};
 } events_context{};
 
@@ -167,7 +258,46 @@ extern "C" void osViSetEvent(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, u32 ret
     next_state->retrace_count = retrace_count;
 }
 
-uint64_t total_vis = 0;
+// Written by the VI thread and read by the emulated clock, RSP task deadlines and wait_one_frame on other threads.
+std::atomic_uint64_t total_vis = 0;
+
+static struct {
+    std::mutex mutex;
+    ultramodern::ViPacingStats stats{};
+} vi_pacing;
+
+static void record_vi_lateness(std::chrono::high_resolution_clock::duration lateness) {
+    auto lateness_ns = std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(lateness), std::chrono::nanoseconds{ 0 });
+    auto lateness_us = std::chrono::duration_cast<std::chrono::microseconds>(lateness_ns).count();
+    const auto& limits = ultramodern::ViPacingStats::bucket_limits_us;
+    size_t bucket = std::upper_bound(limits.begin(), limits.end(), lateness_us) - limits.begin();
+
+    std::lock_guard lock{ vi_pacing.mutex };
+    vi_pacing.stats.buckets[bucket]++;
+    vi_pacing.stats.tick_count++;
+    vi_pacing.stats.total_lateness += lateness_ns;
+    vi_pacing.stats.max_lateness = std::max(vi_pacing.stats.max_lateness, lateness_ns);
+}
+
+static struct {
+    std::mutex mutex;
+    ultramodern::ViCatchUpControl control{};
+    ultramodern::ViCatchUpStats stats{};
+    // Missed VIs that haven't been delivered or skipped yet.
+    uint64_t pending_vis = 0;
+    // Number of pending VIs delivered per tick under the Spread policy.
+    uint64_t spread_rate = 0;
+} vi_catch_up;
+
+ultramodern::ViPacingStats ultramodern::get_vi_pacing_stats() {
+    std::lock_guard lock{ vi_pacing.mutex };
+    return vi_pacing.stats;
+}
+
+void ultramodern::reset_vi_pacing_stats() {
+    std::lock_guard lock{ vi_pacing.mutex };
+    vi_pacing.stats = {};
+}
 
 
 extern std::atomic_bool exited;
@@ -175,6 +305,245 @@ extern moodycamel::LightweightSemaphore graphics_shutdown_ready;
 
 void set_dummy_vi(bool odd);
 
+void ultramodern::set_gfx_queue_control(const GfxQueueControl& control) {
+    std::lock_guard lock{ events_context.gfx_queue_control_mutex };
+    events_context.gfx_queue_control = control;
+}
+
+static ultramodern::GfxQueueControl get_gfx_queue_control() {
+    std::lock_guard lock{ events_context.gfx_queue_control_mutex };
+    return events_context.gfx_queue_control;
+}
+
+ultramodern::GfxQueueStats ultramodern::get_gfx_queue_stats() {
+    const auto& stats = events_context.gfx_queue_stats;
+    return GfxQueueStats{
+        .display_lists = stats.display_lists.load(),
+        .screen_updates_presented = stats.screen_updates_presented.load(),
+        .screen_updates_coalesced = stats.screen_updates_coalesced.load(),
+        .screen_updates_dropped = stats.screen_updates_dropped.load(),
+        .display_list_blocks = stats.display_list_blocks.load(),
+        .display_list_block_time = std::chrono::nanoseconds{ stats.display_list_block_time_ns.load() },
+    };
+}
+
+// Marks a screen update as finished for the purposes of uncapped VI pacing, whether it was presented or not.
+static void complete_screen_update() {
+    events_context.screen_updates_completed++;
+    events_context.screen_update_completed_semaphore.signal();
+}
+
+static void send_screen_update(const ultramodern::renderer::ViRegs& regs) {
+    auto& lanes = events_context.gfx_lanes;
+    bool coalesced;
+    {
+        std::lock_guard lock{ lanes.mutex };
+        // Only the latest VI state is worth presenting, so replace any screen update the graphics thread hasn't reached yet.
+        coalesced = lanes.screen_update.has_value();
+        lanes.screen_update = ScreenUpdateAction{ regs, lanes.next_sequence++, std::chrono::high_resolution_clock::now() };
+    }
+    lanes.action_ready.notify_one();
+
+    if (coalesced) {
+        events_context.gfx_queue_stats.screen_updates_coalesced++;
+        complete_screen_update();
+    }
+}
+
+static void commit_frame_timeline(const ultramodern::FrameTimeline& timeline) {
+    auto& frame_timelines = events_context.frame_timelines;
+    std::lock_guard lock{ frame_timelines.mutex };
+    frame_timelines.records[frame_timelines.write_count % frame_timelines.records.size()] = timeline;
+    frame_timelines.write_count++;
+}
+
+std::vector<ultramodern::FrameTimeline> ultramodern::get_frame_timelines(uint64_t after_frame_id) {
+    auto& frame_timelines = events_context.frame_timelines;
+    std::lock_guard lock{ frame_timelines.mutex };
+    uint64_t count = std::min<uint64_t>(frame_timelines.write_count, frame_timelines.records.size());
+    std::vector<FrameTimeline> ret{};
+    ret.reserve(count);
+    for (uint64_t i = frame_timelines.write_count - count; i < frame_timelines.write_count; i++) {
+        const FrameTimeline& timeline = frame_timelines.records[i % frame_timelines.records.size()];
+        if (timeline.frame_id > after_frame_id) {
+            ret.push_back(timeline);
+        }
+    }
+    return ret;
+}
+
+static void send_display_list(const OSTask& task) {
+    ultramodern::FrameTimeline timeline{};
+    timeline.vi_time = std::chrono::high_resolution_clock::time_point{ std::chrono::high_resolution_clock::duration{ events_context.last_vi_time.load() } };
+    timeline.submit_time = std::chrono::high_resolution_clock::now();
+    {
+        std::lock_guard lock{ events_context.frame_timelines.mutex };
+        timeline.frame_id = events_context.frame_timelines.next_frame_id++;
+    }
+
+    auto& lanes = events_context.gfx_lanes;
+    uint32_t max_pending = get_gfx_queue_control().max_pending_display_lists;
+    {
+        std::unique_lock lock{ lanes.mutex };
+        if (max_pending != 0 && lanes.display_lists.size() >= max_pending) {
+            // Block the game until the graphics thread catches up so that it can't run ahead of the renderer.
+            auto block_start = std::chrono::high_resolution_clock::now();
+            lanes.display_list_consumed.wait(lock, [&]() { return lanes.display_lists.size() < max_pending || lanes.shutdown; });
+            auto block_time = std::chrono::high_resolution_clock::now() - block_start;
+            events_context.gfx_queue_stats.display_list_blocks++;
+            events_context.gfx_queue_stats.display_list_block_time_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(block_time).count();
+        }
+        lanes.display_lists.push_back(SpTaskAction{ task, lanes.next_sequence++, timeline });
+    }
+    lanes.action_ready.notify_one();
+}
+
+static void send_config_update() {
+    auto& lanes = events_context.gfx_lanes;
+    {
+        std::lock_guard lock{ lanes.mutex };
+        lanes.config_update = true;
+    }
+    lanes.action_ready.notify_one();
+}
+
+// Waits for the next action for the graphics thread. Config updates are handled first, then display lists and screen
+// updates in the order they were sent.
+static Action wait_for_gfx_action() {
+    auto& lanes = events_context.gfx_lanes;
+    std::unique_lock lock{ lanes.mutex };
+    lanes.action_ready.wait(lock, [&]() {
+        return lanes.shutdown || lanes.config_update || !lanes.display_lists.empty() || lanes.screen_update.has_value();
+    });
+
+    if (lanes.shutdown) {
+        return ShutdownAction{};
+    }
+    if (lanes.config_update) {
+        lanes.config_update = false;
+        return UpdateConfigAction{};
+    }
+    if (!lanes.display_lists.empty() && (!lanes.screen_update.has_value() || lanes.display_lists.front().sequence < lanes.screen_update->sequence)) {
+        SpTaskAction action = std::move(lanes.display_lists.front());
+        lanes.display_lists.pop_front();
+        lock.unlock();
+        lanes.display_list_consumed.notify_all();
+        return action;
+    }
+    ScreenUpdateAction action = *lanes.screen_update;
+    lanes.screen_update.reset();
+    return action;
+}
+
+// Sleeps until the host time of the next VI at the current speed factor.
+static void wait_for_next_vi() {
+    using namespace std::chrono_literals;
+    // Determine the next VI time (more accurate than adding 16ms each VI interrupt)
+    auto next = ultramodern::emulated_to_host_time(total_vis.load(std::memory_order_relaxed) * 1000000000ns / 60);
+    // Detect if there's more than a second to wait and wait a fixed amount instead for the next VI if so, as that usually means the system clock went back in time.
+    if (std::chrono::floor<std::chrono::seconds>(next - std::chrono::high_resolution_clock::now()) > 1s) {
+        next = std::chrono::high_resolution_clock::now();
+    }
+    ultramodern::sleep_until(next);
+    record_vi_lateness(std::chrono::high_resolution_clock::now() - next);
+}
+
+// Waits until the graphics thread has room for another screen update, which paces uncapped VIs to the renderer.
+// The wait is bounded so that VIs keep being sent if the graphics thread isn't running.
+static void wait_for_screen_update_capacity() {
+    constexpr uint64_t max_pending_screen_updates = 2;
+    constexpr int64_t max_wait_us = 100'000;
+    while (!exited && events_context.screen_updates_sent - events_context.screen_updates_completed >= max_pending_screen_updates) {
+        if (!events_context.screen_update_completed_semaphore.wait(max_wait_us)) {
+            return;
+        }
+    }
+}
+
+void ultramodern::set_vi_catch_up_control(const ViCatchUpControl& control) {
+    std::lock_guard lock{ vi_catch_up.mutex };
+    vi_catch_up.control = control;
+}
+
+ultramodern::ViCatchUpStats ultramodern::get_vi_catch_up_stats() {
+    std::lock_guard lock{ vi_catch_up.mutex };
+    return vi_catch_up.stats;
+}
+
+// Applies the catch-up policy after a VI tick that found the given number of VIs had been missed since the previous tick.
+// Returns how many missed VIs should be delivered in addition to the current one.
+static uint64_t plan_vi_catch_up(uint64_t missed_vis) {
+    uint64_t delivered_vis;
+    {
+        std::lock_guard lock{ vi_catch_up.mutex };
+        const ultramodern::ViCatchUpControl& control = vi_catch_up.control;
+        ultramodern::ViCatchUpStats& stats = vi_catch_up.stats;
+
+        if (missed_vis > 0) {
+            stats.late_ticks++;
+            stats.missed_vis += missed_vis;
+            vi_catch_up.pending_vis += missed_vis;
+        }
+
+        // Missed VIs are skipped outright under SkipToPresent or if there are more than the catch-up limit.
+        uint64_t max_pending = control.policy == ultramodern::ViCatchUpPolicy::SkipToPresent ? 0 : control.max_catch_up_vis;
+        if (vi_catch_up.pending_vis > max_pending) {
+            stats.skipped_vis += vi_catch_up.pending_vis - max_pending;
+            vi_catch_up.pending_vis = max_pending;
+        }
+
+        if (missed_vis > 0 && control.policy == ultramodern::ViCatchUpPolicy::Spread) {
+            uint64_t spread_vis = std::max<uint64_t>(control.spread_vis, 1);
+            vi_catch_up.spread_rate = (vi_catch_up.pending_vis + spread_vis - 1) / spread_vis;
+        }
+
+        if (control.policy == ultramodern::ViCatchUpPolicy::Spread) {
+            delivered_vis = std::min(vi_catch_up.pending_vis, vi_catch_up.spread_rate);
+        }
+        else {
+            delivered_vis = vi_catch_up.pending_vis;
+        }
+        vi_catch_up.pending_vis -= delivered_vis;
+        stats.caught_up_vis += delivered_vis;
+    }
+
+    if (missed_vis > 0 && events_callbacks.vi_late_callback != nullptr) {
+        events_callbacks.vi_late_callback(missed_vis);
+    }
+
+    return delivered_vis;
+}
+
+// Performs one VI retrace: latches the next VI state and sends the VI and AI events to the game.
+static void deliver_vi(int& remaining_retraces) {
+    // Update VI registers and swap VI modes.
+    events_context.vi.update_vi();
+
+    // If the game has started, handle sending VI and AI events.
+    if (ultramodern::is_game_started()) {
+        remaining_retraces--;
+
+        std::lock_guard lock{ events_context.message_mutex };
+        ViState* cur_state = events_context.vi.get_cur_state();
+        if (remaining_retraces == 0) {
+            if (cur_state->mq != NULLPTR) {
+                // Send a message to the VI queue, and do not set it to be requeued if the queue was full.
+                // The worst case scenario is that the game misses a VI message and has to wait a little longer for the next. 
+                ultramodern::enqueue_external_message_src(cur_state->mq, cur_state->msg, false, ultramodern::EventMessageSource::Vi);
+            }
+            remaining_retraces = cur_state->retrace_count;
+        }
+        if (events_context.ai.mq != NULLPTR) {
+            // Send a message to the VI queue, and do not set it to be requeued if the queue was full for the same reason as the VI message above.
+            ultramodern::enqueue_external_message_src(events_context.ai.mq, events_context.ai.msg, false, ultramodern::EventMessageSource::Ai);
+        }
+    }
+
+    if (events_callbacks.vi_callback != nullptr) {
+        events_callbacks.vi_callback();
+    }
+}
+
 void vi_thread_func() {
     ultramodern::set_native_thread_name("VI Thread");
     // This thread should be prioritized over every other thread in the application, as it's what allows
@@ -185,29 +554,22 @@ void vi_thread_func() {
     int remaining_retraces = 1;
 
     while (!exited) {
-        // Determine the next VI time (more accurate than adding 16ms each VI interrupt)
-        auto next = ultramodern::get_start() + (total_vis * 1000000us) / (60 * ultramodern::get_speed_multiplier());
-        //if (next > std::chrono::high_resolution_clock::now()) {
-        //    printf("Sleeping for %" PRIu64 " us to get from %" PRIu64 " us to %" PRIu64 " us \n",
-        //        (next - std::chrono::high_resolution_clock::now()) / 1us,
-        //        (std::chrono::high_resolution_clock::now() - events_context.start) / 1us,
-        //        (next - events_context.start) / 1us);
-        //} else {
-        //    printf("No need to sleep\n");
-        //}
-        // Detect if there's more than a second to wait and wait a fixed amount instead for the next VI if so, as that usually means the system clock went back in time.
-        if (std::chrono::floor<std::chrono::seconds>(next - std::chrono::high_resolution_clock::now()) > 1s) {
-            // printf("Skipping the next VI wait\n");
-            next = std::chrono::high_resolution_clock::now();
+        if (ultramodern::get_speed_factor().uncapped) {
+            wait_for_screen_update_capacity();
+            // Jump emulated time to this VI instead of waiting for it.
+            ultramodern::advance_emulated_time(total_vis.load(std::memory_order_relaxed) * 1000000000ns / 60);
         }
-        ultramodern::sleep_until(next);
-        auto time_now = ultramodern::time_since_start();
-        // Calculate how many VIs have passed
-        uint64_t new_total_vis = (time_now * (60 * ultramodern::get_speed_multiplier()) / 1000ms) + 1;
-        if (new_total_vis > total_vis + 1) {
-            //printf("Skipped % " PRId64 " frames in VI interupt thread!\n", new_total_vis - total_vis - 1);
+        else {
+            wait_for_next_vi();
         }
-        total_vis = new_total_vis;
+        events_context.last_vi_time = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+        auto time_now = ultramodern::emulated_time_since_start();
+        // Calculate how many VIs have passed
+        uint64_t new_total_vis = (time_now * 60 / 1000ms) + 1;
+        uint64_t old_total_vis = total_vis.load(std::memory_order_relaxed);
+        uint64_t missed_vis = new_total_vis > old_total_vis + 1 ? new_total_vis - old_total_vis - 1 : 0;
+        total_vis.store(new_total_vis, std::memory_order_relaxed);
+        uint64_t catch_up_vis = plan_vi_catch_up(missed_vis);
 
         // If the game hasn't started yet, set a dummy VI mode and origin.
         if (!ultramodern::is_game_started()) {
@@ -218,35 +580,43 @@ void vi_thread_func() {
 
         // Queue a screen update for the graphics thread with the current VI register state.
         // Doing this before the VI update is equivalent to updating the screen after the previous frame's scanout finished.
-        events_context.action_queue.enqueue(ScreenUpdateAction{ events_context.vi.regs });
+        events_context.screen_updates_sent++;
+        send_screen_update(events_context.vi.regs);
 
-        // Update VI registers and swap VI modes.
-        events_context.vi.update_vi();
-
-        // If the game has started, handle sending VI and AI events.
-        if (ultramodern::is_game_started()) {
-            remaining_retraces--;
-            
-            std::lock_guard lock{ events_context.message_mutex };
-            ViState* cur_state = events_context.vi.get_cur_state();
-            if (remaining_retraces == 0) {
-                if (cur_state->mq != NULLPTR) {
-                    // Send a message to the VI queue, and do not set it to be requeued if the queue was full.
-                    // The worst case scenario is that the game misses a VI message and has to wait a little longer for the next. 
-                    ultramodern::enqueue_external_message_src(cur_state->mq, cur_state->msg, false, ultramodern::EventMessageSource::Vi);
-                }
-                remaining_retraces = cur_state->retrace_count;
-            }
-            if (events_context.ai.mq != NULLPTR) {
-                // Send a message to the VI queue, and do not set it to be requeued if the queue was full for the same reason as the VI message above.
-                ultramodern::enqueue_external_message_src(events_context.ai.mq, events_context.ai.msg, false, ultramodern::EventMessageSource::Ai);
-            }
+        // Deliver this VI along with any missed ones that the catch-up policy wants delivered now.
+        for (uint64_t i = 0; i <= catch_up_vis; i++) {
+            deliver_vi(remaining_retraces);
         }
 
-        if (events_callbacks.vi_callback != nullptr) {
-            events_callbacks.vi_callback();
-        }
+        events_context.host_update_semaphore.signal();
+        ultramodern::report_thread_wakeup();
+    }
+}
+
+void ultramodern::wait_for_host_update(std::chrono::microseconds timeout) {
+    if (timeout.count() == 0) {
+        events_context.host_update_semaphore.wait();
     }
+    else {
+        events_context.host_update_semaphore.wait(timeout.count());
+    }
+    // Consume any extra signals so that a slow host loop doesn't run repeatedly to catch up on missed VIs.
+    while (events_context.host_update_semaphore.tryWait()) {}
+}
+
+void ultramodern::request_host_update() {
+    events_context.host_update_semaphore.signal();
+}
+
+void ultramodern::wake_threads_for_exit() {
+    events_context.host_update_semaphore.signal();
+    auto& lanes = events_context.gfx_lanes;
+    {
+        std::lock_guard lock{ lanes.mutex };
+        lanes.shutdown = true;
+    }
+    lanes.action_ready.notify_all();
+    lanes.display_list_consumed.notify_all();
 }
 
 void sp_complete() {
@@ -261,29 +631,93 @@ void dp_complete() {
     ultramodern::enqueue_external_message_src(events_context.dp.mq, events_context.dp.msg, false, ultramodern::EventMessageSource::Dp);
 }
 
-void task_thread_func(uint8_t* rdram, moodycamel::LightweightSemaphore* thread_ready) {
+void ultramodern::set_rsp_task_control(const RspTaskControl& control) {
+    std::lock_guard lock{ events_context.rsp_task_control_mutex };
+    events_context.rsp_task_control = control;
+}
+
+static ultramodern::RspTaskControl get_rsp_task_control() {
+    std::lock_guard lock{ events_context.rsp_task_control_mutex };
+    return events_context.rsp_task_control;
+}
+
+std::unordered_map<uint32_t, ultramodern::RspTaskTypeStats> ultramodern::get_rsp_task_stats() {
+    std::lock_guard lock{ events_context.sp_task_stats.mutex };
+    return events_context.sp_task_stats.by_type;
+}
+
+static void record_sp_task_stats(const SpTaskRequest& request, std::chrono::high_resolution_clock::time_point start_time,
+    std::chrono::high_resolution_clock::time_point end_time)
+{
+    std::lock_guard lock{ events_context.sp_task_stats.mutex };
+    ultramodern::RspTaskTypeStats& stats = events_context.sp_task_stats.by_type[request.task->t.type];
+    stats.completed++;
+    stats.total_wait_time += start_time - request.submit_time;
+    if (end_time > request.deadline) {
+        stats.deadlines_missed++;
+        stats.max_lateness = std::max(stats.max_lateness, std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - request.deadline));
+    }
+}
+
+// Returns the time by which the given task should finish. Audio tasks must finish before the audio backend runs out of
+// queued samples, and everything else should finish before the next VI.
+static std::chrono::high_resolution_clock::time_point get_sp_task_deadline(const OSTask* task, std::chrono::high_resolution_clock::time_point now) {
+    using namespace std::chrono_literals;
+    if (task->t.type == M_AUDTASK) {
+        std::optional<std::chrono::microseconds> buffered = ultramodern::get_buffered_audio_duration();
+        if (buffered.has_value()) {
+            return now + buffered.value();
+        }
+    }
+    return std::max(now, ultramodern::emulated_to_host_time(total_vis.load(std::memory_order_relaxed) * 1000000000ns / 60));
+}
+
+// Records that the task with the given sequence number has finished and sends the completion for every task that's now
+// finished in submission order.
+static void finish_sp_task(uint64_t sequence) {
+    auto& completion = events_context.sp_task_completion;
+    std::lock_guard lock{ completion.mutex };
+    completion.finished.insert(sequence);
+    while (!completion.finished.empty() && *completion.finished.begin() == completion.next_completion) {
+        completion.finished.erase(completion.finished.begin());
+        completion.next_completion++;
+        // Tell the game that the RSP has completed
+        sp_complete();
+    }
+}
+
+void task_thread_func(uint8_t* rdram, moodycamel::LightweightSemaphore* thread_ready, uint32_t executor_index) {
     ultramodern::set_native_thread_name("SP Task Thread");
     ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::Normal);
 
+    auto executor = std::make_unique<ultramodern::rsp::ExecutorContext>();
+    executor->index = executor_index;
+
     // Notify the caller thread that this thread is ready.
     thread_ready->signal();
 
     while (true) {
-        // Wait until an RSP task has been sent
-        OSTask* task;
-        events_context.sp_task_queue.wait_dequeue(task);
-
-        if (task == nullptr) {
-            return;
+        // Wait until an RSP task has been sent, and exit once there are none left after shutdown has been requested.
+        SpTaskRequest request;
+        {
+            auto& queue = events_context.sp_task_queue;
+            std::unique_lock lock{ queue.mutex };
+            queue.task_ready.wait(lock, [&]() { return queue.shutdown || !queue.tasks.empty(); });
+            if (queue.tasks.empty()) {
+                return;
+            }
+            request = queue.tasks.top();
+            queue.tasks.pop();
         }
+        auto start_time = std::chrono::high_resolution_clock::now();
 
-        if (!ultramodern::rsp::run_task(PASS_RDRAM task)) {
-            fprintf(stderr, "Failed to execute task type: %" PRIu32 "\n", task->t.type);
+        if (!ultramodern::rsp::run_task(PASS_RDRAM request.task, executor.get())) {
+            fprintf(stderr, "Failed to execute task type: %" PRIu32 "\n", request.task->t.type);
             ULTRAMODERN_QUICK_EXIT();
         }
 
-        // Tell the game that the RSP has completed
-        sp_complete();
+        record_sp_task_stats(request, start_time, std::chrono::high_resolution_clock::now());
+        finish_sp_task(request.sequence);
     }
 }
 
@@ -313,7 +747,7 @@ float ultramodern::get_resolution_scale() {
 }
 
 void ultramodern::trigger_config_action() {
-    events_context.action_queue.enqueue(UpdateConfigAction{});
+    send_config_update();
 }
 
 std::atomic<ultramodern::renderer::SetupResult> renderer_setup_result = ultramodern::renderer::SetupResult::Success;
@@ -321,7 +755,6 @@ std::atomic<ultramodern::renderer::GraphicsApi> renderer_chosen_api = ultramoder
 
 void gfx_thread_func(uint8_t* rdram, moodycamel::LightweightSemaphore* thread_ready, ultramodern::renderer::WindowHandle window_handle) {
     bool enabled_instant_present = false;
-    using namespace std::chrono_literals;
 
     ultramodern::set_native_thread_name("Gfx Thread");
     ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::Normal);
@@ -347,49 +780,80 @@ void gfx_thread_func(uint8_t* rdram, moodycamel::LightweightSemaphore* thread_re
     // Notify the caller thread that this thread is ready.
     thread_ready->signal();
 
+    // Timelines of rendered frames that are waiting for the next screen update.
+    std::vector<ultramodern::FrameTimeline> pending_timelines{};
+    constexpr size_t max_pending_timelines = 16;
+
     while (!exited) {
-        // Try to pull an action from the queue
-        Action action;
-        if (events_context.action_queue.wait_dequeue_timed(action, 1ms)) {
-            // Determine the action type and act on it
-            if (const auto* task_action = std::get_if<SpTaskAction>(&action)) {
-                // Turn on instant present if the game has been started and it hasn't been turned on yet.
-                if (ultramodern::is_game_started() && !enabled_instant_present) {
-                    renderer_context->enable_instant_present();
-                    enabled_instant_present = true;
-                }
-                // Tell the game that the RSP completed instantly. This will allow it to queue other task types, but it won't
-                // start another graphics task until the RDP is also complete. Games usually preserve the RSP inputs until the RDP
-                // is finished as well, so sending this early shouldn't be an issue in most cases.
-                // If this causes issues then the logic can be replaced with responding to yield requests.
-                sp_complete();
-                ultramodern::measure_input_latency();
-
-                PTR(u64) displaylist = task_action->task.t.data_ptr;
-                ultramodern::extensions::on_displaylist_submitted(displaylist);
-
-                [[maybe_unused]] auto renderer_start = std::chrono::high_resolution_clock::now();
-                renderer_context->send_dl(&task_action->task);
-                [[maybe_unused]] auto renderer_end = std::chrono::high_resolution_clock::now();
-
-                dp_complete();
-                // TODO hook the parsed event up to the actual parsing point when a callback is added to RT64.
-                ultramodern::extensions::on_displaylist_parsed(displaylist);
-                ultramodern::extensions::on_displaylist_completed(displaylist);
-                // printf("Renderer ProcessDList time: %d us\n", static_cast<u32>(std::chrono::duration_cast<std::chrono::microseconds>(renderer_end - renderer_start).count()));
+        // Wait for an action to come in.
+        Action action = wait_for_gfx_action();
+        ultramodern::report_thread_wakeup();
+
+        // Determine the action type and act on it
+        if (const auto* task_action = std::get_if<SpTaskAction>(&action)) {
+            // Turn on instant present if the game has been started and it hasn't been turned on yet.
+            if (ultramodern::is_game_started() && !enabled_instant_present) {
+                renderer_context->enable_instant_present();
+                enabled_instant_present = true;
+            }
+            // Tell the game that the RSP completed instantly. This will allow it to queue other task types, but it won't
+            // start another graphics task until the RDP is also complete. Games usually preserve the RSP inputs until the RDP
+            // is finished as well, so sending this early shouldn't be an issue in most cases.
+            // If this causes issues then the logic can be replaced with responding to yield requests.
+            sp_complete();
+            ultramodern::measure_input_latency();
+            events_context.gfx_queue_stats.display_lists++;
+
+            PTR(u64) displaylist = task_action->task.t.data_ptr;
+            ultramodern::extensions::on_displaylist_submitted(displaylist);
+
+            ultramodern::FrameTimeline timeline = task_action->timeline;
+            timeline.renderer_start_time = std::chrono::high_resolution_clock::now();
+            renderer_context->send_dl(&task_action->task);
+            timeline.renderer_end_time = std::chrono::high_resolution_clock::now();
+
+            dp_complete();
+            timeline.dp_complete_time = std::chrono::high_resolution_clock::now();
+            // TODO hook the parsed event up to the actual parsing point when a callback is added to RT64.
+            ultramodern::extensions::on_displaylist_parsed(displaylist);
+            ultramodern::extensions::on_displaylist_completed(displaylist);
+
+            // Frames that never reach a screen update are recorded without one so that the timeline keeps moving.
+            if (pending_timelines.size() >= max_pending_timelines) {
+                commit_frame_timeline(pending_timelines.front());
+                pending_timelines.erase(pending_timelines.begin());
             }
-            else if (const auto* screen_update_action = std::get_if<ScreenUpdateAction>(&action)) {
+            pending_timelines.push_back(timeline);
+        }
+        else if (const auto* screen_update_action = std::get_if<ScreenUpdateAction>(&action)) {
+            auto max_age = get_gfx_queue_control().max_screen_update_age;
+            if (max_age.count() != 0 && std::chrono::high_resolution_clock::now() - screen_update_action->sent_time > max_age) {
+                // The renderer has fallen too far behind for this frame to be worth presenting.
+                events_context.gfx_queue_stats.screen_updates_dropped++;
+            }
+            else {
                 events_context.vi.update_screen_regs = screen_update_action->regs;
+                auto screen_update_start = std::chrono::high_resolution_clock::now();
                 renderer_context->update_screen();
+                auto screen_update_end = std::chrono::high_resolution_clock::now();
                 display_refresh_rate = renderer_context->get_display_framerate();
                 resolution_scale = renderer_context->get_resolution_scale();
-            }
-            else if (const auto* config_action = std::get_if<UpdateConfigAction>(&action)) {
-                (void)config_action;
-                auto new_config = ultramodern::renderer::get_graphics_config();
-                if (renderer_context->update_config(old_config, new_config)) {
-                    old_config = new_config;
+                events_context.gfx_queue_stats.screen_updates_presented++;
+
+                for (ultramodern::FrameTimeline& timeline : pending_timelines) {
+                    timeline.screen_update_start_time = screen_update_start;
+                    timeline.screen_update_end_time = screen_update_end;
+                    commit_frame_timeline(timeline);
                 }
+                pending_timelines.clear();
+            }
+            complete_screen_update();
+        }
+        else if (const auto* config_action = std::get_if<UpdateConfigAction>(&action)) {
+            (void)config_action;
+            auto new_config = ultramodern::renderer::get_graphics_config();
+            if (renderer_context->update_config(old_config, new_config)) {
+                old_config = new_config;
             }
         }
     }
@@ -557,11 +1021,28 @@ void ultramodern::submit_rsp_task(RDRAM_ARG PTR(OSTask) task_) {
 
     // Send gfx tasks to the graphics action queue
     if (task->t.type == M_GFXTASK) {
-        events_context.action_queue.enqueue(SpTaskAction{ *task });
+        send_display_list(*task);
     }
     // Set all other tasks as the RSP task
     else {
-        events_context.sp_task_queue.enqueue(task);
+        SpTaskRequest request{ .task = task };
+        {
+            std::lock_guard lock{ events_context.sp_task_completion.mutex };
+            request.sequence = events_context.sp_task_completion.next_sequence++;
+        }
+        {
+            std::lock_guard lock{ events_context.rsp_task_control_mutex };
+            auto find_it = events_context.rsp_task_control.task_priorities.find(task->t.type);
+            request.priority = find_it == events_context.rsp_task_control.task_priorities.end() ? 0 : find_it->second;
+        }
+        request.submit_time = std::chrono::high_resolution_clock::now();
+        request.deadline = get_sp_task_deadline(task, request.submit_time);
+
+        {
+            std::lock_guard lock{ events_context.sp_task_queue.mutex };
+            events_context.sp_task_queue.tasks.push(request);
+        }
+        events_context.sp_task_queue.task_ready.notify_one();
     }
 }
 
@@ -574,12 +1055,17 @@ void ultramodern::init_events(RDRAM_ARG ultramodern::renderer::WindowHandle wind
     moodycamel::LightweightSemaphore task_thread_ready;
     events_context.rdram = rdram;
     events_context.sp.gfx_thread = std::thread{ gfx_thread_func, rdram, &gfx_thread_ready, window_handle };
-    events_context.sp.task_thread = std::thread{ task_thread_func, rdram, &task_thread_ready };
+    uint32_t executor_count = std::max(get_rsp_task_control().executor_count, 1U);
+    for (uint32_t i = 0; i < executor_count; i++) {
+        events_context.sp.task_threads.emplace_back(task_thread_func, rdram, &task_thread_ready, i);
+    }
 
-    // Wait for the two sp threads to be ready before continuing to prevent the game from
+    // Wait for the sp threads to be ready before continuing to prevent the game from
     // running before we're able to handle RSP tasks.
     gfx_thread_ready.wait();
-    task_thread_ready.wait();
+    for (uint32_t i = 0; i < executor_count; i++) {
+        task_thread_ready.wait();
+    }
 
     ultramodern::renderer::SetupResult setup_result = renderer_setup_result.load();
     if (setup_result != ultramodern::renderer::SetupResult::Success) {
@@ -616,7 +1102,14 @@ void ultramodern::join_event_threads() {
     events_context.sp.gfx_thread.join();
     events_context.vi.thread.join();
 
-    // Send a null RSP task to indicate that the RSP task thread should exit.
-    events_context.sp_task_queue.enqueue(nullptr);
-    events_context.sp.task_thread.join();
+    // Tell the RSP task threads to exit once they've run any remaining tasks.
+    {
+        std::lock_guard lock{ events_context.sp_task_queue.mutex };
+        events_context.sp_task_queue.shutdown = true;
+    }
+    events_context.sp_task_queue.task_ready.notify_all();
+    for (std::thread& task_thread : events_context.sp.task_threads) {
+        task_thread.join();
+    }
+    events_context.sp.task_threads.clear();
 }
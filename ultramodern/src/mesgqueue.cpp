@@ -1,5 +1,13 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
 #include <bitset>
+#include <chrono>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "blockingconcurrentqueue.h"
 
@@ -7,15 +15,80 @@
 #include "ultramodern/ultramodern.hpp"
 
 struct QueuedMessage {
-    PTR(OSMesgQueue) mq;
-    OSMesg mesg;
-    bool jam;
-    bool requeue_if_blocked;
+    PTR(OSMesgQueue) mq = NULLPTR;
+    OSMesg mesg = NULLPTR;
+    bool jam = false;
+    bool requeue_if_blocked = false;
+    // Only set when stats are being collected.
+    std::chrono::high_resolution_clock::time_point enqueue_time{};
+};
+
+// Messages from non-game threads waiting to be delivered by a game thread. Each destination message queue hashes to one
+// lane so that delivery only touches the lanes that have pending messages. A lane is a ring buffer that only grows if
+// it fills up, so delivering messages doesn't allocate in the steady state. Messages that couldn't be delivered because
+// their queue was full stay at the front of their lane instead of being requeued.
+struct MessageLane {
+    std::mutex mutex;
+    std::vector<QueuedMessage> ring = std::vector<QueuedMessage>(16);
+    size_t head = 0;
+    size_t count = 0;
+
+    void push(const QueuedMessage& mesg) {
+        if (count == ring.size()) {
+            // Unroll the ring into a larger buffer.
+            std::vector<QueuedMessage> new_ring(ring.size() * 2);
+            for (size_t i = 0; i < count; i++) {
+                new_ring[i] = ring[(head + i) % ring.size()];
+            }
+            ring = std::move(new_ring);
+            head = 0;
+        }
+        ring[(head + count) % ring.size()] = mesg;
+        count++;
+    }
 };
 
-static moodycamel::BlockingConcurrentQueue<QueuedMessage> external_messages {};
+constexpr size_t message_lane_count = 64;
+static std::array<MessageLane, message_lane_count> message_lanes{};
+// Bitmask of the lanes that have pending messages, which lets game threads skip delivery when nothing is pending.
+static std::atomic_uint64_t pending_message_lanes = 0;
+// Signaled for each enqueued message to wake game threads that are waiting for one. A single wakeup delivers every pending
+// message, so waiters consume the extra signals before delivering. Receiving from a full queue signals again for any messages
+// that were kept in its lane, since their signals were consumed without delivering them.
+static moodycamel::LightweightSemaphore external_message_available{};
 std::bitset<32> requeue_enabled;
 
+static std::atomic_bool collect_stats = false;
+static struct {
+    std::mutex mutex;
+    std::unordered_map<PTR(OSMesgQueue), ultramodern::MessageQueueStats> by_queue;
+} mesg_queue_stats;
+
+// Runs the given function on the stats for a queue if stats are being collected.
+template <typename F>
+static void update_queue_stats(PTR(OSMesgQueue) mq, F&& func) {
+    if (collect_stats.load(std::memory_order_relaxed)) {
+        std::lock_guard lock{ mesg_queue_stats.mutex };
+        func(mesg_queue_stats.by_queue[mq]);
+    }
+}
+
+std::unordered_map<PTR(OSMesgQueue), ultramodern::MessageQueueStats> ultramodern::get_message_queue_stats() {
+    std::lock_guard lock{ mesg_queue_stats.mutex };
+    return mesg_queue_stats.by_queue;
+}
+
+void ultramodern::reset_message_queue_stats() {
+    std::lock_guard lock{ mesg_queue_stats.mutex };
+    mesg_queue_stats.by_queue.clear();
+}
+
+static size_t get_message_lane_index(PTR(OSMesgQueue) mq) {
+    // Fibonacci hash of the queue's address.
+    uint64_t hash = (static_cast<uint64_t>(static_cast<uint32_t>(mq)) >> 3) * 0x9E3779B97F4A7C15ULL;
+    return hash >> (64 - std::countr_zero(message_lane_count));
+}
+
 void ultramodern::set_message_queue_control(const ultramodern::MessageQueueControl& mqc) {
     requeue_enabled.reset();
     requeue_enabled.set(static_cast<int>(EventMessageSource::Timer), mqc.requeue_timer);
@@ -25,45 +98,122 @@ void ultramodern::set_message_queue_control(const ultramodern::MessageQueueContr
     requeue_enabled.set(static_cast<int>(EventMessageSource::Vi), mqc.requeue_vi);
     requeue_enabled.set(static_cast<int>(EventMessageSource::Pi), mqc.requeue_pi);
     requeue_enabled.set(static_cast<int>(EventMessageSource::Dp), mqc.requeue_dp);
+    collect_stats = mqc.collect_stats;
 }
 
 void ultramodern::enqueue_external_message_src(PTR(OSMesgQueue) mq, OSMesg msg, bool jam, EventMessageSource src) {
-    external_messages.enqueue({mq, msg, jam, requeue_enabled[static_cast<int>(src)]});
+    enqueue_external_message(mq, msg, jam, requeue_enabled[static_cast<int>(src)]);
 }
 
 void ultramodern::enqueue_external_message(PTR(OSMesgQueue) mq, OSMesg msg, bool jam, bool requeue_if_blocked) {
-    external_messages.enqueue({mq, msg, jam, requeue_if_blocked});
+    size_t lane_index = get_message_lane_index(mq);
+    MessageLane& lane = message_lanes[lane_index];
+    {
+        std::lock_guard lock{ lane.mutex };
+        QueuedMessage mesg{mq, msg, jam, requeue_if_blocked};
+        if (collect_stats.load(std::memory_order_relaxed)) {
+            mesg.enqueue_time = std::chrono::high_resolution_clock::now();
+        }
+        lane.push(mesg);
+        pending_message_lanes.fetch_or(uint64_t(1) << lane_index, std::memory_order_release);
+    }
+    external_message_available.signal();
 }
 
 bool do_send(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, bool jam, bool block);
 
-void dequeue_external_messages(RDRAM_ARG1) {
-    QueuedMessage to_send;
-    std::vector<QueuedMessage> requeued_messages{};
-    while (external_messages.try_dequeue(to_send)) {
-        if (!do_send(PASS_RDRAM to_send.mq, to_send.mesg, to_send.jam, false) && to_send.requeue_if_blocked) {
-            requeued_messages.push_back(to_send);
+// Delivers the pending messages in a lane in order. Once a message for a given queue stays pending, any later messages
+// for that queue also stay pending so that they arrive in order.
+static void deliver_lane_messages(RDRAM_ARG size_t lane_index) {
+    MessageLane& lane = message_lanes[lane_index];
+    std::lock_guard lock{ lane.mutex };
+
+    std::array<PTR(OSMesgQueue), 8> blocked_queues;
+    size_t blocked_count = 0;
+    // Set if more queues are blocked than can be tracked, in which case the rest of the lane is left for the next pass.
+    bool lane_blocked = false;
+    size_t kept_count = 0;
+    size_t ring_size = lane.ring.size();
+
+    for (size_t i = 0; i < lane.count; i++) {
+        QueuedMessage& cur_mesg = lane.ring[(lane.head + i) % ring_size];
+        bool queue_blocked = std::find(blocked_queues.begin(), blocked_queues.begin() + blocked_count, cur_mesg.mq) != blocked_queues.begin() + blocked_count;
+        bool keep;
+        bool delivered = false;
+        if (queue_blocked) {
+            // The queue is still full, so this message only stays pending if it would have been requeued anyway.
+            keep = cur_mesg.requeue_if_blocked;
+        }
+        else if (lane_blocked) {
+            keep = true;
+        }
+        else if (do_send(PASS_RDRAM cur_mesg.mq, cur_mesg.mesg, cur_mesg.jam, false)) {
+            keep = false;
+            delivered = true;
+            update_queue_stats(cur_mesg.mq, [&](ultramodern::MessageQueueStats& stats) {
+                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - cur_mesg.enqueue_time);
+                // Messages enqueued before stats were enabled have no timestamp.
+                if (cur_mesg.enqueue_time.time_since_epoch().count() != 0) {
+                    stats.total_delivery_latency += latency;
+                    stats.max_delivery_latency = std::max(stats.max_delivery_latency, latency);
+                }
+                stats.external_deliveries++;
+            });
+        }
+        else {
+            keep = cur_mesg.requeue_if_blocked;
+            if (keep) {
+                if (blocked_count == blocked_queues.size()) {
+                    lane_blocked = true;
+                }
+                else {
+                    blocked_queues[blocked_count++] = cur_mesg.mq;
+                }
+            }
+        }
+
+        if (keep) {
+            lane.ring[(lane.head + kept_count) % ring_size] = cur_mesg;
+            kept_count++;
+            update_queue_stats(cur_mesg.mq, [](ultramodern::MessageQueueStats& stats) { stats.requeues++; });
+        }
+        else if (!delivered) {
+            update_queue_stats(cur_mesg.mq, [](ultramodern::MessageQueueStats& stats) { stats.external_drops++; });
         }
     }
-    for (QueuedMessage& cur_mesg : requeued_messages) {
-        external_messages.enqueue(cur_mesg);
+
+    lane.count = kept_count;
+    if (kept_count == 0) {
+        lane.head = 0;
+        pending_message_lanes.fetch_and(~(uint64_t(1) << lane_index), std::memory_order_relaxed);
     }
 }
 
-void ultramodern::wait_for_external_message(RDRAM_ARG1) {
-    QueuedMessage to_send;
-    external_messages.wait_dequeue(to_send);
-    if (!do_send(PASS_RDRAM to_send.mq, to_send.mesg, to_send.jam, false) && to_send.requeue_if_blocked) {
-        external_messages.enqueue(to_send);
+void dequeue_external_messages(RDRAM_ARG1) {
+    uint64_t pending_lanes = pending_message_lanes.load(std::memory_order_acquire);
+    while (pending_lanes != 0) {
+        size_t lane_index = std::countr_zero(pending_lanes);
+        pending_lanes &= pending_lanes - 1;
+        deliver_lane_messages(PASS_RDRAM lane_index);
     }
 }
 
+// Consumes the signals of messages that are about to be delivered along with the one that woke the caller. This has to happen
+// before delivery, as a message enqueued after its lane has been checked would otherwise lose its signal and stay pending.
+static void consume_extra_message_signals() {
+    while (external_message_available.tryWait()) {}
+}
+
+void ultramodern::wait_for_external_message(RDRAM_ARG1) {
+    external_message_available.wait();
+    consume_extra_message_signals();
+    dequeue_external_messages(PASS_RDRAM1);
+}
+
 void ultramodern::wait_for_external_message_timed(RDRAM_ARG u32 millis) {
-    QueuedMessage to_send;
-    if (external_messages.wait_dequeue_timed(to_send, std::chrono::milliseconds{millis})) {
-        if (!do_send(PASS_RDRAM to_send.mq, to_send.mesg, to_send.jam, false) && to_send.requeue_if_blocked) {
-            external_messages.enqueue(to_send);
-        }
+    if (external_message_available.wait(int64_t(millis) * 1000)) {
+        consume_extra_message_signals();
+        dequeue_external_messages(PASS_RDRAM1);
     }
 }
 
@@ -97,13 +247,18 @@ bool do_send(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, bool jam, bool block) {
             return false;
         }
     }
-    else {
+    else if (MQ_IS_FULL(mq)) {
         // Otherwise, yield this thread until the queue has room.
+        auto block_start = std::chrono::high_resolution_clock::now();
         while (MQ_IS_FULL(mq)) {
             debug_printf("[Message Queue] Thread %d is blocked on send\n", TO_PTR(OSThread, ultramodern::this_thread())->id);
             ultramodern::thread_queue_insert(PASS_RDRAM GET_MEMBER(OSMesgQueue, mq_, blocked_on_send), ultramodern::this_thread());
             ultramodern::run_next_thread_and_wait(PASS_RDRAM1);
         }
+        update_queue_stats(mq_, [&](ultramodern::MessageQueueStats& stats) {
+            stats.full_blocks++;
+            stats.full_blocked_time += std::chrono::high_resolution_clock::now() - block_start;
+        });
     }
     
     if (jam) {
@@ -119,6 +274,10 @@ bool do_send(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, bool jam, bool block) {
         mq->validCount++;
     }
 
+    update_queue_stats(mq_, [&](ultramodern::MessageQueueStats& stats) {
+        stats.max_depth = std::max(stats.max_depth, mq->validCount);
+    });
+
     // If any threads were blocked on receiving from this message queue, pop the first one and schedule it.
     PTR(PTR(OSThread)) blocked_queue = GET_MEMBER(OSMesgQueue, mq_, blocked_on_recv);
     if (!ultramodern::thread_queue_empty(PASS_RDRAM blocked_queue)) {
@@ -135,22 +294,34 @@ bool do_recv(RDRAM_ARG PTR(OSMesgQueue) mq_, PTR(OSMesg) msg_, bool block) {
         if (MQ_IS_EMPTY(mq)) {
             return false;
         }
-    } else {
+    } else if (MQ_IS_EMPTY(mq)) {
         // Otherwise, yield this thread in a loop until the queue is no longer full
+        auto block_start = std::chrono::high_resolution_clock::now();
         while (MQ_IS_EMPTY(mq)) {
             debug_printf("[Message Queue] Thread %d is blocked on receive\n", TO_PTR(OSThread, ultramodern::this_thread())->id);
             ultramodern::thread_queue_insert(PASS_RDRAM GET_MEMBER(OSMesgQueue, mq_, blocked_on_recv), ultramodern::this_thread());
             ultramodern::run_next_thread_and_wait(PASS_RDRAM1);
         }
+        update_queue_stats(mq_, [&](ultramodern::MessageQueueStats& stats) {
+            stats.empty_blocks++;
+            stats.empty_blocked_time += std::chrono::high_resolution_clock::now() - block_start;
+        });
     }
 
     if (msg_ != NULLPTR) {
         *TO_PTR(OSMesg, msg_) = TO_PTR(OSMesg, mq->msg)[mq->first];
     }
     
+    bool was_full = MQ_IS_FULL(mq);
     mq->first = (mq->first + 1) % mq->msgCount;
     mq->validCount--;
 
+    // Messages from other threads that were kept in their lane because this queue was full no longer have a signal of their
+    // own, so signal that they can be delivered now instead of waiting for an unrelated message to wake a waiting thread.
+    if (was_full && (pending_message_lanes.load(std::memory_order_relaxed) & (uint64_t(1) << get_message_lane_index(mq_))) != 0) {
+        external_message_available.signal();
+    }
+
     // If any threads were blocked on sending to this message queue, pop the first one and schedule it.
     PTR(PTR(OSThread)) blocked_queue = GET_MEMBER(OSMesgQueue, mq_, blocked_on_send);
     if (!ultramodern::thread_queue_empty(PASS_RDRAM blocked_queue)) {
@@ -175,6 +346,16 @@ extern "C" s32 osSendMesg(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, s32 flags)
 
     // Try to send the message.
     bool sent = do_send(PASS_RDRAM mq_, msg, jam, flags == OS_MESG_BLOCK);
+    if (sent) {
+        update_queue_stats(mq_, [&](ultramodern::MessageQueueStats& stats) {
+            if (jam) {
+                stats.jams++;
+            }
+            else {
+                stats.sends++;
+            }
+        });
+    }
     
     // Check the queue to see if this thread should swap execution to another.
     ultramodern::check_running_queue(PASS_RDRAM1);
@@ -197,6 +378,16 @@ extern "C" s32 osJamMesg(RDRAM_ARG PTR(OSMesgQueue) mq_, OSMesg msg, s32 flags)
 
     // Try to send the message.
     bool sent = do_send(PASS_RDRAM mq_, msg, jam, flags == OS_MESG_BLOCK);
+    if (sent) {
+        update_queue_stats(mq_, [&](ultramodern::MessageQueueStats& stats) {
+            if (jam) {
+                stats.jams++;
+            }
+            else {
+                stats.sends++;
+            }
+        });
+    }
     
     // Check the queue to see if this thread should swap execution to another.
     ultramodern::check_running_queue(PASS_RDRAM1);
@@ -214,6 +405,9 @@ extern "C" s32 osRecvMesg(RDRAM_ARG PTR(OSMesgQueue) mq_, PTR(OSMesg) msg_, s32
 
     // Try to receive a message.
     bool received = do_recv(PASS_RDRAM mq_, msg_, flags == OS_MESG_BLOCK);
+    if (received) {
+        update_queue_stats(mq_, [](ultramodern::MessageQueueStats& stats) { stats.receives++; });
+    }
     
     // Check the queue to see if this thread should swap execution to another.
     ultramodern::check_running_queue(PASS_RDRAM1);
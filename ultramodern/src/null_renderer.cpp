@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+
+#include "ultramodern/null_renderer.hpp"
+
+// Size of the RDRAM that display lists can reference.
+constexpr uint32_t rdram_size = 0x800000;
+// Upper bound on the commands walked in a single display list, which catches display lists that loop forever.
+constexpr uint32_t max_commands_per_dl = 4 * 1024 * 1024;
+constexpr uint32_t g_dl_push = 0x00;
+constexpr uint32_t g_mw_segment = 0x06;
+
+struct DisplayListOpcodes {
+    uint8_t dl;
+    uint8_t enddl;
+    uint8_t moveword;
+    // Maximum call depth supported by the microcode's display list stack.
+    uint32_t stack_depth;
+};
+
+constexpr DisplayListOpcodes f3d_opcodes{ .dl = 0x06, .enddl = 0xB8, .moveword = 0xBC, .stack_depth = 10 };
+constexpr DisplayListOpcodes f3dex2_opcodes{ .dl = 0xDE, .enddl = 0xDF, .moveword = 0xDB, .stack_depth = 18 };
+
+static std::mutex null_renderer_mutex;
+static ultramodern::renderer::NullRendererConfig null_renderer_config{};
+static ultramodern::renderer::NullRendererStats null_renderer_stats{};
+
+void ultramodern::renderer::set_null_renderer_config(const NullRendererConfig& config) {
+    std::lock_guard lock{ null_renderer_mutex };
+    null_renderer_config = config;
+}
+
+ultramodern::renderer::NullRendererStats ultramodern::renderer::get_null_renderer_stats() {
+    std::lock_guard lock{ null_renderer_mutex };
+    return null_renderer_stats;
+}
+
+std::unique_ptr<ultramodern::renderer::RendererContext> ultramodern::renderer::create_null_render_context(uint8_t* rdram, WindowHandle window_handle, bool developer_mode) {
+    NullRendererConfig config;
+    {
+        std::lock_guard lock{ null_renderer_mutex };
+        config = null_renderer_config;
+    }
+    return std::make_unique<NullRendererContext>(rdram, config);
+}
+
+ultramodern::renderer::NullRendererContext::NullRendererContext(uint8_t* rdram, const NullRendererConfig& config) :
+    rdram(rdram), config(config), last_screen_update(std::chrono::high_resolution_clock::now()) {
+    setup_result = SetupResult::Success;
+    chosen_api = GraphicsApi::Auto;
+}
+
+ultramodern::renderer::NullRendererContext::~NullRendererContext() = default;
+
+void ultramodern::renderer::NullRendererContext::send_dl(const OSTask* task) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // The segment table is reset for every task.
+    segments.fill(0);
+    bool dl_valid = walk_display_list(static_cast<uint32_t>(task->t.data_ptr) & 0x1FFFFFFF);
+
+    cur_frame.dl_count++;
+    if (!dl_valid) {
+        cur_frame.invalid_dl_count++;
+    }
+    cur_frame.dl_time += std::chrono::high_resolution_clock::now() - start;
+}
+
+bool ultramodern::renderer::NullRendererContext::walk_display_list(uint32_t address) {
+    const DisplayListOpcodes& opcodes = config.format == DisplayListFormat::F3D ? f3d_opcodes : f3dex2_opcodes;
+    std::array<uint32_t, 32> stack;
+    uint32_t stack_size = 0;
+    uint32_t command_count = 0;
+    // FNV-1a, applied to whole commands instead of individual bytes.
+    uint64_t hash = cur_frame.dl_hash == 0 ? 0xCBF29CE484222325ULL : cur_frame.dl_hash;
+
+    auto fail = [&](const char* reason) {
+        if (config.log_invalid_dls) {
+            fprintf(stderr, "[WARN] Invalid display list in frame %" PRIu64 ": %s at 0x%08X\n", cur_frame.frame_index, reason, address);
+        }
+        cur_frame.command_count += command_count;
+        return false;
+    };
+
+    auto resolve_segmented = [&](uint32_t segmented) {
+        return (segments[(segmented >> 24) & 0x0F] + (segmented & 0x00FFFFFF)) & 0x00FFFFFF;
+    };
+
+    while (true) {
+        if ((address & 0x7) != 0) {
+            return fail("misaligned command");
+        }
+        if (address >= rdram_size) {
+            return fail("command outside of RDRAM");
+        }
+        if (command_count >= max_commands_per_dl) {
+            return fail("command limit exceeded");
+        }
+
+        uint32_t w0 = *reinterpret_cast<const uint32_t*>(rdram + address);
+        uint32_t w1 = *reinterpret_cast<const uint32_t*>(rdram + address + 4);
+        uint8_t opcode = w0 >> 24;
+        command_count++;
+
+        if (config.hash_frames) {
+            hash = (hash ^ ((uint64_t(w0) << 32) | w1)) * 0x100000001B3ULL;
+        }
+
+        address += 8;
+
+        if (opcode == opcodes.enddl) {
+            if (stack_size == 0) {
+                break;
+            }
+            address = stack[--stack_size];
+        }
+        else if (opcode == opcodes.dl) {
+            if (((w0 >> 16) & 0xFF) == g_dl_push) {
+                if (stack_size >= opcodes.stack_depth) {
+                    return fail("display list stack overflow");
+                }
+                stack[stack_size++] = address;
+            }
+            address = resolve_segmented(w1);
+        }
+        else if (opcode == opcodes.moveword) {
+            uint32_t index;
+            uint32_t offset;
+            if (config.format == DisplayListFormat::F3D) {
+                index = w0 & 0xFF;
+                offset = (w0 >> 8) & 0xFFFF;
+            }
+            else {
+                index = (w0 >> 16) & 0xFF;
+                offset = w0 & 0xFFFF;
+            }
+            if (index == g_mw_segment) {
+                segments[(offset / 4) & 0x0F] = w1 & 0x00FFFFFF;
+            }
+        }
+    }
+
+    cur_frame.command_count += command_count;
+    if (config.hash_frames) {
+        cur_frame.dl_hash = hash;
+    }
+    return true;
+}
+
+void ultramodern::renderer::NullRendererContext::update_screen() {
+    auto now = std::chrono::high_resolution_clock::now();
+    cur_frame.frame_time = now - last_screen_update;
+    last_screen_update = now;
+
+    {
+        std::lock_guard lock{ null_renderer_mutex };
+        null_renderer_stats.frame_count++;
+        null_renderer_stats.dl_count += cur_frame.dl_count;
+        null_renderer_stats.command_count += cur_frame.command_count;
+        null_renderer_stats.invalid_dl_count += cur_frame.invalid_dl_count;
+        null_renderer_stats.total_dl_time += cur_frame.dl_time;
+        null_renderer_stats.max_frame_time = std::max(null_renderer_stats.max_frame_time, cur_frame.frame_time);
+        null_renderer_stats.last_frame = cur_frame;
+    }
+
+    if (config.frame_callback) {
+        config.frame_callback(cur_frame);
+    }
+
+    cur_frame = NullRendererFrame{ .frame_index = cur_frame.frame_index + 1 };
+}
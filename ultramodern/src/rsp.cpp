@@ -20,3 +20,11 @@ bool ultramodern::rsp::run_task(RDRAM_ARG const OSTask* task) {
 
     return rsp_callbacks.run_task(PASS_RDRAM task);
 }
+
+bool ultramodern::rsp::run_task(RDRAM_ARG const OSTask* task, ExecutorContext* executor) {
+    if (rsp_callbacks.run_executor_task != nullptr) {
+        return rsp_callbacks.run_executor_task(PASS_RDRAM task, executor);
+    }
+
+    return run_task(PASS_RDRAM task);
+}
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <thread>
+
+#include "ultramodern/thread_baton.hpp"
+
+#if defined(_WIN32)
+#include <Windows.h>
+#elif defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+static std::atomic<int64_t> max_spin_ns{ 20000 };
+// Starts out as a typical futex wakeup latency until a sleeping waiter has been measured.
+static std::atomic<int64_t> wake_latency_ns{ 10000 };
+static std::atomic<uint64_t> baton_signals{ 0 };
+static std::atomic<uint64_t> baton_spin_hits{ 0 };
+static std::atomic<uint64_t> baton_spin_misses{ 0 };
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+    _mm_pause();
+#elif defined(_M_ARM64)
+    __yield();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void wait_on_address(std::atomic<int32_t>& value, int32_t expected) {
+#if defined(_WIN32)
+    WaitOnAddress(&value, &expected, sizeof(expected), INFINITE);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(&value), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+#else
+    value.wait(expected);
+#endif
+}
+
+static void wake_address(std::atomic<int32_t>& value) {
+#if defined(_WIN32)
+    WakeByAddressSingle(&value);
+#elif defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(&value), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#else
+    value.notify_one();
+#endif
+}
+
+// Spinning only pays off if it's shorter than the cost of sleeping and being woken, and never if the signalling thread can't
+// run at the same time as the waiter.
+static int64_t get_spin_window_ns() {
+    static const bool single_core = std::thread::hardware_concurrency() <= 1;
+    if (single_core) {
+        return 0;
+    }
+    return std::min(max_spin_ns.load(std::memory_order_relaxed), wake_latency_ns.load(std::memory_order_relaxed));
+}
+
+bool ultramodern::ThreadBaton::try_acquire() {
+    int32_t cur = value.load(std::memory_order_relaxed);
+    while (cur > 0) {
+        if (value.compare_exchange_weak(cur, cur - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ultramodern::ThreadBaton::signal() {
+    baton_signals.fetch_add(1, std::memory_order_relaxed);
+
+    int32_t cur = value.load(std::memory_order_relaxed);
+    while (true) {
+        if (cur < 0) {
+            // The waiter is asleep, so hand it the signal directly and wake it.
+            signal_time.store(now_ns(), std::memory_order_relaxed);
+            if (value.compare_exchange_weak(cur, 1, std::memory_order_release, std::memory_order_relaxed)) {
+                wake_address(value);
+                return;
+            }
+        }
+        else if (value.compare_exchange_weak(cur, cur + 1, std::memory_order_release, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+void ultramodern::ThreadBaton::wait() {
+    if (try_acquire()) {
+        baton_spin_hits.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    int64_t spin_window = get_spin_window_ns();
+    if (spin_window > 0) {
+        int64_t spin_start = now_ns();
+        uint32_t spin_count = 0;
+        while (true) {
+            cpu_relax();
+            if (try_acquire()) {
+                baton_spin_hits.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            // Only check the clock periodically to keep it from dominating the spin loop.
+            if ((++spin_count % 32) == 0 && now_ns() - spin_start >= spin_window) {
+                break;
+            }
+        }
+    }
+
+    baton_spin_misses.fetch_add(1, std::memory_order_relaxed);
+
+    bool slept = false;
+    while (true) {
+        int32_t cur = value.load(std::memory_order_relaxed);
+        if (cur > 0) {
+            if (value.compare_exchange_weak(cur, cur - 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                break;
+            }
+            continue;
+        }
+        // Mark this thread as asleep so that the next signal knows to wake it.
+        if (cur == 0 && !value.compare_exchange_weak(cur, -1, std::memory_order_relaxed)) {
+            continue;
+        }
+        wait_on_address(value, -1);
+        slept = true;
+    }
+
+    if (slept) {
+        // Exponential moving average with a weight of 1/8 for the new sample.
+        int64_t latency = now_ns() - signal_time.load(std::memory_order_relaxed);
+        int64_t average = wake_latency_ns.load(std::memory_order_relaxed);
+        wake_latency_ns.store(average + (latency - average) / 8, std::memory_order_relaxed);
+    }
+}
+
+void ultramodern::set_thread_baton_max_spin(std::chrono::nanoseconds max_spin) {
+    max_spin_ns.store(max_spin.count(), std::memory_order_relaxed);
+}
+
+ultramodern::ThreadBatonStats ultramodern::get_thread_baton_stats() {
+    return ThreadBatonStats{
+        .signals = baton_signals.load(std::memory_order_relaxed),
+        .spin_hits = baton_spin_hits.load(std::memory_order_relaxed),
+        .spin_misses = baton_spin_misses.load(std::memory_order_relaxed),
+        .wake_latency = std::chrono::nanoseconds{ wake_latency_ns.load(std::memory_order_relaxed) },
+        .spin_window = std::chrono::nanoseconds{ get_spin_window_ns() },
+    };
+}
@@ -1,7 +1,11 @@
 #include <cstdio>
+#include <cstdlib>
 #include <thread>
 #include <cassert>
 #include <string>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include "ultramodern/ultra64.h"
 #include "ultramodern/ultramodern.hpp"
@@ -14,6 +18,13 @@
 #include <Windows.h>
 #endif
 
+// Used to run game threads as user-space contexts.
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
 static ultramodern::threads::callbacks_t threads_callbacks;
 
 void ultramodern::threads::set_callbacks(const callbacks_t& callbacks) {
@@ -27,12 +38,48 @@ std::string ultramodern::threads::get_game_thread_name(const OSThread* t) {
     return threads_callbacks.get_game_thread_name(t);
 }
 
+static std::array<ultramodern::threads::game_thread_local_destructor_t*, ultramodern::threads::max_game_thread_locals> game_thread_local_destructors{};
+static std::atomic_uint32_t game_thread_local_count = 0;
+
+ultramodern::threads::GameThreadLocals::~GameThreadLocals() {
+    for (uint32_t slot = 0; slot < max_game_thread_locals; slot++) {
+        if (values[slot] != nullptr) {
+            game_thread_local_destructors[slot](values[slot]);
+        }
+    }
+}
+
+uint32_t ultramodern::threads::reserve_game_thread_local(game_thread_local_destructor_t* destructor) {
+    uint32_t slot = game_thread_local_count.fetch_add(1);
+    if (slot >= max_game_thread_locals) {
+        throw std::runtime_error("Ran out of game thread local slots");
+    }
+    game_thread_local_destructors[slot] = destructor;
+    return slot;
+}
+
 extern "C" void bootproc();
 
 thread_local bool is_entrypoint_thread = false;
 // Whether this thread is part of the game (i.e. the start thread or one spawned by osCreateThread)
 thread_local bool is_game_thread = false;
 thread_local PTR(OSThread) thread_self = NULLPTR;
+// The game thread locals of the running OSThread, or null if this thread isn't one.
+thread_local ultramodern::threads::GameThreadLocals* game_thread_locals = nullptr;
+// Used instead of game_thread_locals by threads that aren't an OSThread.
+thread_local ultramodern::threads::GameThreadLocals host_thread_locals{};
+
+static ultramodern::threads::GameThreadLocals& get_game_thread_locals() {
+    return game_thread_locals != nullptr ? *game_thread_locals : host_thread_locals;
+}
+
+void* ultramodern::threads::get_game_thread_local(uint32_t slot) {
+    return get_game_thread_locals().values[slot];
+}
+
+void ultramodern::threads::set_game_thread_local(uint32_t slot, void* value) {
+    get_game_thread_locals().values[slot] = value;
+}
 
 void ultramodern::set_entrypoint_thread() {
     ::is_game_thread = true;
@@ -61,6 +108,30 @@ void run_thread_function(uint8_t* rdram, uint64_t addr, uint64_t sp, uint64_t ar
 #define run_thread_function(func, sp, arg) func(arg)
 #endif
 
+static std::mutex scheduling_control_mutex;
+static ultramodern::ThreadSchedulingControl scheduling_control{};
+
+void ultramodern::set_thread_scheduling_control(const ThreadSchedulingControl& control) {
+    std::lock_guard lock{ scheduling_control_mutex };
+    scheduling_control = control;
+    ultramodern::set_thread_baton_max_spin(control.max_handoff_spin);
+}
+
+static ultramodern::ThreadSchedulingControl get_thread_scheduling_control() {
+    std::lock_guard lock{ scheduling_control_mutex };
+    return scheduling_control;
+}
+
+// Returns the CPUs the given thread should be pinned to, or an empty list if it isn't pinned.
+static std::vector<uint32_t> get_thread_cpu_affinity(const std::string& name) {
+    std::lock_guard lock{ scheduling_control_mutex };
+    auto find_it = scheduling_control.cpu_affinity.find(name);
+    if (find_it == scheduling_control.cpu_affinity.end()) {
+        return {};
+    }
+    return find_it->second;
+}
+
 #if defined(_WIN32)
 void ultramodern::set_native_thread_name(const std::string& name) {
     std::wstring wname{name.begin(), name.end()};
@@ -70,6 +141,19 @@ void ultramodern::set_native_thread_name(const std::string& name) {
         GetCurrentThread(),
         wname.c_str()
     );
+
+    std::vector<uint32_t> cpus = get_thread_cpu_affinity(name);
+    if (!cpus.empty()) {
+        DWORD_PTR mask = 0;
+        for (uint32_t cpu : cpus) {
+            if (cpu < sizeof(mask) * 8) {
+                mask |= DWORD_PTR(1) << cpu;
+            }
+        }
+        if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+            fprintf(stderr, "[WARN] Failed to set the CPU affinity of thread '%s'\n", name.c_str());
+        }
+    }
 }
 
 void ultramodern::set_native_thread_priority(ThreadPriority pri) {
@@ -100,6 +184,10 @@ void ultramodern::set_native_thread_priority(ThreadPriority pri) {
 }
 #elif defined(__linux__)
 #include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <unistd.h>
 
 void ultramodern::set_native_thread_name(const std::string& name) {
     if (name.length() > 15) {
@@ -108,34 +196,93 @@ void ultramodern::set_native_thread_name(const std::string& name) {
     }
 
     prctl(PR_SET_NAME, name.c_str());
+
+    std::vector<uint32_t> cpus = get_thread_cpu_affinity(name);
+    if (!cpus.empty()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        for (uint32_t cpu : cpus) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &cpu_set);
+            }
+        }
+        // A pid of 0 applies to the calling thread.
+        if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+            fprintf(stderr, "[WARN] Failed to set the CPU affinity of thread '%s'\n", name.c_str());
+        }
+    }
+}
+
+// Attempts to switch the calling thread to a realtime policy. This follows the same rules as rtkit: the priority is clamped
+// to RLIMIT_RTPRIO for unprivileged processes and SCHED_RESET_ON_FORK is set so that child processes don't inherit it.
+static bool set_realtime_priority(int policy, int priority) {
+    if (geteuid() != 0) {
+        struct rlimit rtprio_limit;
+        if (getrlimit(RLIMIT_RTPRIO, &rtprio_limit) != 0 || rtprio_limit.rlim_cur == 0) {
+            return false;
+        }
+        if (rtprio_limit.rlim_cur != RLIM_INFINITY && rlim_t(priority) > rtprio_limit.rlim_cur) {
+            priority = static_cast<int>(rtprio_limit.rlim_cur);
+        }
+    }
+
+    struct sched_param param{};
+    param.sched_priority = priority;
+    // sched_setscheduler with a pid of 0 applies to the calling thread on Linux.
+    return sched_setscheduler(0, policy | SCHED_RESET_ON_FORK, &param) == 0;
 }
 
 void ultramodern::set_native_thread_priority(ThreadPriority pri) {
-    // TODO linux thread priority
-    // printf("set_native_thread_priority unimplemented\n");
-    // int nPriority = THREAD_PRIORITY_NORMAL;
-
-    // // Convert ThreadPriority to Win32 priority
-    // switch (pri) {
-    //     case ThreadPriority::Low:
-    //         nPriority = THREAD_PRIORITY_BELOW_NORMAL;
-    //         break;
-    //     case ThreadPriority::Normal:
-    //         nPriority = THREAD_PRIORITY_NORMAL;
-    //         break;
-    //     case ThreadPriority::High:
-    //         nPriority = THREAD_PRIORITY_ABOVE_NORMAL;
-    //         break;
-    //     case ThreadPriority::VeryHigh:
-    //         nPriority = THREAD_PRIORITY_HIGHEST;
-    //         break;
-    //     case ThreadPriority::Critical:
-    //         nPriority = THREAD_PRIORITY_TIME_CRITICAL;
-    //         break;
-    //     default:
-    //         throw std::runtime_error("Invalid thread priority!");
-    //         break;
-    // }
+    ThreadSchedulingControl control = get_thread_scheduling_control();
+    int nice_value = 0;
+    int realtime_policy = SCHED_FIFO;
+    int realtime_priority = 1;
+    bool background = false;
+
+    switch (pri) {
+        case ThreadPriority::Low:
+            nice_value = 10;
+            background = true;
+            break;
+        case ThreadPriority::Normal:
+            nice_value = 0;
+            break;
+        case ThreadPriority::High:
+            nice_value = -5;
+            realtime_policy = SCHED_RR;
+            realtime_priority = 1;
+            break;
+        case ThreadPriority::VeryHigh:
+            nice_value = -10;
+            realtime_priority = 2;
+            break;
+        case ThreadPriority::Critical:
+            nice_value = -15;
+            realtime_priority = 3;
+            break;
+        default:
+            throw std::runtime_error("Invalid thread priority!");
+            break;
+    }
+
+    if (control.allow_realtime && pri >= control.realtime_threshold && pri > ThreadPriority::Normal) {
+        if (set_realtime_priority(realtime_policy, realtime_priority)) {
+            return;
+        }
+
+        static std::atomic_bool warned = false;
+        if (!warned.exchange(true)) {
+            fprintf(stderr, "[WARN] Realtime thread priorities aren't permitted, falling back to nice values. Raise RLIMIT_RTPRIO to allow them.\n");
+        }
+    }
+
+    // Background threads use SCHED_BATCH so that they don't preempt interactive threads.
+    struct sched_param param{};
+    sched_setscheduler(0, (background ? SCHED_BATCH : SCHED_OTHER) | SCHED_RESET_ON_FORK, &param);
+
+    // setpriority with a thread ID only affects that thread on Linux. Raising priority (lowering the nice value) requires
+    // RLIMIT_NICE or CAP_SYS_NICE, so failures are ignored and the thread keeps its current nice value.
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), nice_value);
 }
 #elif defined(__APPLE__)
 void ultramodern::set_native_thread_name(const std::string& name) {
@@ -150,6 +297,174 @@ void ultramodern::set_native_thread_name(const std::string& name) {
 void ultramodern::set_native_thread_priority(ThreadPriority pri) {}
 #endif
 
+#if defined(_WIN32) || defined(__linux__)
+constexpr bool user_contexts_supported = true;
+#else
+constexpr bool user_contexts_supported = false;
+#endif
+
+// A game thread running as a user-space context. Contexts are only ever entered on the "Game Threads" host thread.
+struct UltraUserContext {
+#if defined(_WIN32)
+    LPVOID fiber = nullptr;
+#elif defined(__linux__)
+    ucontext_t context;
+    uint8_t* stack = nullptr;
+    size_t stack_size = 0;
+#endif
+    uint8_t* rdram = nullptr;
+    PTR(OSThread) self = NULLPTR;
+    PTR(thread_func_t) entrypoint = NULLPTR;
+    PTR(void) arg = NULLPTR;
+};
+
+static struct {
+    // The host thread's own context, which waits for the first game thread to be started.
+    UltraUserContext host;
+    // A game thread that exited and switched away from its own stack, which is freed by the next context that runs.
+    UltraThreadContext* dead = nullptr;
+    // The context to return to once a game thread that was destroyed by another one has finished unwinding.
+    UltraUserContext* unwind_return = nullptr;
+    // Game threads started from outside of a game thread, which the host thread enters.
+    moodycamel::BlockingConcurrentQueue<OSThread*> start_requests;
+    std::once_flag host_started;
+} user_contexts;
+
+// Whether game threads run as user-space contexts. Latched on first use, as the mode can't change once threads exist.
+static bool use_user_contexts() {
+    static const bool enabled = [] {
+        bool requested = get_thread_scheduling_control().user_space_game_threads;
+        if (requested && !user_contexts_supported) {
+            fprintf(stderr, "[WARN] User-space game threads aren't supported on this platform, using host threads instead\n");
+        }
+        return requested && user_contexts_supported;
+    }();
+    return enabled;
+}
+
+static void _thread_func(RDRAM_ARG PTR(OSThread) self_, PTR(thread_func_t) entrypoint, PTR(void) arg, UltraThreadContext* thread_context);
+
+static void reap_dead_user_context() {
+    UltraThreadContext* dead = user_contexts.dead;
+    if (dead == nullptr) {
+        return;
+    }
+    user_contexts.dead = nullptr;
+
+    debug_printf("[Cleanup] Deleting user context %p\n", dead);
+#if defined(_WIN32)
+    DeleteFiber(dead->user_context->fiber);
+#elif defined(__linux__)
+    munmap(dead->user_context->stack, dead->user_context->stack_size);
+#endif
+    delete dead->user_context;
+    delete dead;
+}
+
+static void user_context_entry(UltraThreadContext* thread_context) {
+    reap_dead_user_context();
+    UltraUserContext* user_context = thread_context->user_context;
+    // Never returns, as the context switches to another one once the thread exits.
+    _thread_func(user_context->rdram, user_context->self, user_context->entrypoint, user_context->arg, thread_context);
+}
+
+#if defined(_WIN32)
+static void WINAPI user_context_fiber_entry(LPVOID param) {
+    user_context_entry(static_cast<UltraThreadContext*>(param));
+}
+#elif defined(__linux__)
+// makecontext only passes int arguments, so the context pointer is split into two halves.
+static void user_context_makecontext_entry(unsigned int high, unsigned int low) {
+    uintptr_t thread_context = static_cast<uintptr_t>((uint64_t(high) << 32) | low);
+    user_context_entry(reinterpret_cast<UltraThreadContext*>(thread_context));
+}
+#endif
+
+static UltraUserContext* create_user_context(RDRAM_ARG PTR(OSThread) t_, PTR(thread_func_t) entrypoint, PTR(void) arg, UltraThreadContext* thread_context) {
+    size_t stack_size = get_thread_scheduling_control().game_thread_stack_size;
+    UltraUserContext* user_context = new UltraUserContext{};
+    user_context->rdram = rdram;
+    user_context->self = t_;
+    user_context->entrypoint = entrypoint;
+    user_context->arg = arg;
+
+#if defined(_WIN32)
+    user_context->fiber = CreateFiberEx(0, stack_size, FIBER_FLAG_FLOAT_SWITCH, user_context_fiber_entry, thread_context);
+    if (user_context->fiber == nullptr) {
+        throw std::runtime_error("Failed to create game thread fiber");
+    }
+#elif defined(__linux__)
+    // Reserve an extra page at the bottom of the stack as a guard page so that overflows fault instead of corrupting memory.
+    size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    stack_size = (stack_size + page_size - 1) / page_size * page_size;
+    user_context->stack_size = stack_size + page_size;
+    void* stack = mmap(nullptr, user_context->stack_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (stack == MAP_FAILED) {
+        throw std::runtime_error("Failed to allocate game thread stack");
+    }
+    user_context->stack = static_cast<uint8_t*>(stack);
+    mprotect(user_context->stack, page_size, PROT_NONE);
+
+    getcontext(&user_context->context);
+    user_context->context.uc_stack.ss_sp = user_context->stack + page_size;
+    user_context->context.uc_stack.ss_size = stack_size;
+    user_context->context.uc_link = nullptr;
+    uintptr_t context_bits = reinterpret_cast<uintptr_t>(thread_context);
+    makecontext(&user_context->context, reinterpret_cast<void(*)()>(user_context_makecontext_entry), 2,
+        static_cast<unsigned int>(uint64_t(context_bits) >> 32), static_cast<unsigned int>(context_bits));
+#endif
+
+    return user_context;
+}
+
+// Saves the current context and switches to another one, returning once the current context is switched back to.
+static void switch_user_context(UltraUserContext* from, UltraUserContext* to) {
+    // All contexts share the host thread's thread locals, so this context's thread has to be restored when it resumes.
+    PTR(OSThread) self = thread_self;
+    ultramodern::threads::GameThreadLocals* locals = game_thread_locals;
+#if defined(_WIN32)
+    (void)from;
+    SwitchToFiber(to->fiber);
+#elif defined(__linux__)
+    swapcontext(&from->context, &to->context);
+#endif
+    thread_self = self;
+    game_thread_locals = locals;
+    reap_dead_user_context();
+}
+
+// Switches to another context without saving the current one, which is deleted by the next context that runs.
+[[noreturn]] static void exit_user_context(UltraThreadContext* thread_context, UltraUserContext* to) {
+    user_contexts.dead = thread_context;
+#if defined(_WIN32)
+    SwitchToFiber(to->fiber);
+#elif defined(__linux__)
+    setcontext(&to->context);
+#endif
+    // Unreachable, the dead context is never switched back to.
+    abort();
+}
+
+static void user_context_host_func() {
+    ultramodern::set_native_thread_name("Game Threads");
+    ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::High);
+    is_game_thread = true;
+
+#if defined(_WIN32)
+    user_contexts.host.fiber = ConvertThreadToFiber(nullptr);
+#endif
+
+    // Game threads only switch back to the host if they're destroyed while it's unwinding them, so this normally
+    // enters the first started thread and never resumes.
+    while (true) {
+        OSThread* to_start;
+        user_contexts.start_requests.wait_dequeue(to_start);
+        if (to_start->context != nullptr) {
+            switch_user_context(&user_contexts.host, to_start->context->user_context);
+        }
+    }
+}
+
 void wait_for_resumed(RDRAM_ARG UltraThreadContext* thread_context) {
     thread_context->running.wait();
     // If this thread's context was replaced by another thread or deleted, destroy it again from its own context.
@@ -164,24 +479,45 @@ void resume_thread(OSThread* t) {
     t->context->running.signal();
 }
 
-void run_next_thread(RDRAM_ARG1) {
+static OSThread* pop_next_thread(RDRAM_ARG1) {
     if (ultramodern::thread_queue_empty(PASS_RDRAM ultramodern::running_queue)) {
         throw std::runtime_error("No threads left to run!\n");
     }
 
     OSThread* to_run = TO_PTR(OSThread, ultramodern::thread_queue_pop(PASS_RDRAM ultramodern::running_queue));
     debug_printf("[Scheduling] Resuming execution of thread %d\n", to_run->id);
-    to_run->context->running.signal();
+    return to_run;
+}
+
+void run_next_thread(RDRAM_ARG1) {
+    pop_next_thread(PASS_RDRAM1)->context->running.signal();
+}
+
+// Swaps directly to the given thread's context and checks whether this thread was replaced or deleted once it resumes.
+static void switch_to_thread_and_wait(RDRAM_ARG UltraThreadContext* cur_context, OSThread* t) {
+    switch_user_context(cur_context->user_context, t->context->user_context);
+    if (TO_PTR(OSThread, ultramodern::this_thread())->context != cur_context) {
+        osDestroyThread(PASS_RDRAM NULLPTR);
+    }
 }
 
 void ultramodern::run_next_thread_and_wait(RDRAM_ARG1) {
     UltraThreadContext* cur_context = TO_PTR(OSThread, thread_self)->context;
+    if (cur_context->user_context != nullptr) {
+        switch_to_thread_and_wait(PASS_RDRAM cur_context, pop_next_thread(PASS_RDRAM1));
+        return;
+    }
     run_next_thread(PASS_RDRAM1);
     wait_for_resumed(PASS_RDRAM cur_context);
 }
 
 void ultramodern::resume_thread_and_wait(RDRAM_ARG OSThread *t) {
     UltraThreadContext* cur_context = TO_PTR(OSThread, thread_self)->context;
+    if (cur_context->user_context != nullptr) {
+        debug_printf("[Thread] Resuming execution of thread %d\n", t->id);
+        switch_to_thread_and_wait(PASS_RDRAM cur_context, t);
+        return;
+    }
     resume_thread(t);
     wait_for_resumed(PASS_RDRAM cur_context);
 }
@@ -190,21 +526,25 @@ static void _thread_func(RDRAM_ARG PTR(OSThread) self_, PTR(thread_func_t) entry
     OSThread *self = TO_PTR(OSThread, self_);
     debug_printf("[Thread] Thread created: %d\n", self->id);
     thread_self = self_;
+    game_thread_locals = &thread_context->locals;
     is_game_thread = true;
 
-    // Set the thread name
-    ultramodern::set_native_thread_name(ultramodern::threads::get_game_thread_name(self));
-    ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::High);
+    // User-space contexts share the host thread's name and priority, and are only entered once they've been started.
+    if (thread_context->user_context == nullptr) {
+        // Set the thread name
+        ultramodern::set_native_thread_name(ultramodern::threads::get_game_thread_name(self));
+        ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::High);
 
-    // Signal the initialized semaphore to indicate that this thread can be started.
-    thread_context->initialized.signal();
+        // Signal the initialized semaphore to indicate that this thread can be started.
+        thread_context->initialized.signal();
 
-    debug_printf("[Thread] Thread waiting to be started: %d\n", self->id);
+        debug_printf("[Thread] Thread waiting to be started: %d\n", self->id);
 
-    // Wait until the thread is marked as running.
-    try {
-        wait_for_resumed(PASS_RDRAM thread_context);
-    } catch (ultramodern::thread_terminated& terminated) {
+        // Wait until the thread is marked as running.
+        try {
+            wait_for_resumed(PASS_RDRAM thread_context);
+        } catch (ultramodern::thread_terminated& terminated) {
+        }
     }
 
     // Make sure the thread wasn't replaced or destroyed before it was started.
@@ -220,6 +560,22 @@ static void _thread_func(RDRAM_ARG PTR(OSThread) self_, PTR(thread_func_t) entry
         debug_printf("[Thread] Thread destroyed before being started: %d\n", self->id);
     }
 
+    if (thread_context->user_context != nullptr) {
+        UltraUserContext* next;
+        // A thread that was destroyed by another one returns to it once it's done unwinding.
+        if (self->context != thread_context && user_contexts.unwind_return != nullptr) {
+            next = user_contexts.unwind_return;
+            user_contexts.unwind_return = nullptr;
+        }
+        else {
+            if (self->context == thread_context) {
+                self->context = nullptr;
+            }
+            next = pop_next_thread(PASS_RDRAM1)->context->user_context;
+        }
+        exit_user_context(thread_context, next);
+    }
+
     // Check if the thread hasn't been destroyed or replaced. If so, then the thread terminated or destroyed itself,
     // so mark this thread as destroyed and run the next queued thread.
     if (self->context == thread_context) {
@@ -243,7 +599,12 @@ extern "C" void osStartThread(RDRAM_ARG PTR(OSThread) t_) {
     // Otherwise, immediately start the thread and terminate this one.
     else {
         t->state = OSThreadState::QUEUED;
-        resume_thread(t);
+        if (t->context->user_context != nullptr) {
+            user_contexts.start_requests.enqueue(t);
+        }
+        else {
+            resume_thread(t);
+        }
         //throw ultramodern::thread_terminated{};
     }
 }
@@ -263,6 +624,18 @@ extern "C" void osCreateThread(RDRAM_ARG PTR(OSThread) t_, OSId id, PTR(thread_f
     // Pass the context as an argument to the thread function to ensure that it can't get cleared before the thread captures its value.
     UltraThreadContext* context = new UltraThreadContext{};
     t->context = context;
+
+    // In user-space mode the context is only entered once the thread is started, so there's nothing to wait for.
+    if (use_user_contexts()) {
+        context->user_context = create_user_context(PASS_RDRAM t_, entrypoint, arg, context);
+        std::call_once(user_contexts.host_started, [] {
+            // Game threads are never joined, so neither is the host thread that runs them.
+            std::thread{user_context_host_func}.detach();
+        });
+        debug_printf("[os] Thread %d is ready to be started\n", t->id);
+        return;
+    }
+
     context->host_thread = std::thread{_thread_func, PASS_RDRAM t_, entrypoint, arg, t->context};
 
     // Wait until the thread is initialized to indicate that it's ready to be started.
@@ -301,7 +674,15 @@ extern "C" void osDestroyThread(RDRAM_ARG PTR(OSThread) t_) {
     if (cur_context != nullptr) {
         // Mark the target thread as destroyed and resume it. When it starts it'll check this and terminate itself instead of resuming.
         t->context = nullptr;
-        cur_context->running.signal();
+        if (cur_context->user_context != nullptr) {
+            // Only one context can run at a time, so this thread waits for the target to finish unwinding.
+            UltraThreadContext* self_context = TO_PTR(OSThread, thread_self)->context;
+            user_contexts.unwind_return = self_context->user_context;
+            switch_user_context(self_context->user_context, cur_context->user_context);
+        }
+        else {
+            cur_context->running.signal();
+        }
     }
 }
 
@@ -343,18 +724,25 @@ PTR(OSThread) ultramodern::this_thread() {
 
 static std::thread thread_cleaner_thread;
 static moodycamel::BlockingConcurrentQueue<UltraThreadContext*> deleted_threads{};
-extern std::atomic_bool exited;
 
 void thread_cleaner_func() {
-    using namespace std::chrono_literals;
-    while (!exited) {
+    ultramodern::set_native_thread_name("Thread Cleaner");
+    ultramodern::set_native_thread_priority(ultramodern::ThreadPriority::Low);
+
+    while (true) {
         UltraThreadContext* to_delete;
-        if (deleted_threads.wait_dequeue_timed(to_delete, 10ms)) {
-            debug_printf("[Cleanup] Deleting thread context %p\n", to_delete);
+        deleted_threads.wait_dequeue(to_delete);
+        ultramodern::report_thread_wakeup();
 
-            to_delete->host_thread.join();
-            delete to_delete;
+        // A null context indicates that the thread cleaner should exit.
+        if (to_delete == nullptr) {
+            return;
         }
+
+        debug_printf("[Cleanup] Deleting thread context %p\n", to_delete);
+
+        to_delete->host_thread.join();
+        delete to_delete;
     }
 }
 
@@ -367,5 +755,33 @@ void ultramodern::cleanup_thread(UltraThreadContext *cur_context) {
 }
 
 void ultramodern::join_thread_cleaner_thread() {
+    // Send a null context to indicate that the thread cleaner should exit.
+    deleted_threads.enqueue(nullptr);
     thread_cleaner_thread.join();
 }
+
+static std::atomic_uint64_t thread_wakeups = 0;
+
+void ultramodern::report_thread_wakeup() {
+    thread_wakeups.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t ultramodern::get_thread_wakeup_count() {
+    return thread_wakeups.load(std::memory_order_relaxed);
+}
+
+double ultramodern::get_thread_wakeups_per_second() {
+    static std::mutex rate_mutex;
+    static std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
+    static uint64_t last_count = 0;
+
+    std::lock_guard lock{ rate_mutex };
+    auto now = std::chrono::steady_clock::now();
+    uint64_t count = get_thread_wakeup_count();
+    double seconds = std::chrono::duration<double>(now - last_time).count();
+    double rate = seconds > 0.0 ? (count - last_count) / seconds : 0.0;
+
+    last_time = now;
+    last_count = count;
+    return rate;
+}
@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <thread>
 #include <variant>
 #include <set>
+#include <mutex>
+#include <cinttypes>
 #include "blockingconcurrentqueue.h"
 
 #include "ultramodern/ultra64.h"
@@ -9,16 +12,28 @@
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include "Windows.h"
+#elif defined(__linux__)
+#include <cerrno>
+#include <ctime>
+#include <sched.h>
+#include <sys/prctl.h>
 #endif
 
 // Start time for the program
 static std::chrono::high_resolution_clock::time_point start_time = std::chrono::high_resolution_clock::now();
 // Offset of the duration since program start used to calculate the value for osGetTime. 
 static int64_t ostime_offset = 0;
-// Game speed multiplier (1 means no speedup)
-constexpr uint32_t speed_multiplier = 1;
 // N64 CPU counter ticks per millisecond
-constexpr uint32_t counter_per_ms = 46'875 * speed_multiplier;
+constexpr uint32_t counter_per_ms = 46'875;
+
+// Mapping from host time to emulated time. Emulated time advances from the anchor at numerator/denominator times the host
+// clock's rate. The anchor is moved whenever the speed factor changes so that emulated time stays continuous.
+static struct {
+    std::mutex mutex;
+    ultramodern::SpeedFactor factor{};
+    std::chrono::high_resolution_clock::time_point host_anchor = start_time;
+    std::chrono::nanoseconds emulated_anchor{ 0 };
+} emulated_clock;
 
 struct OSTimer {
     PTR(OSTimer) unused1;
@@ -37,7 +52,11 @@ struct RemoveTimerAction {
     PTR(OSTimer) timer;
 };
 
-using Action = std::variant<AddTimerAction, RemoveTimerAction>;
+// Wakes the timer thread so it recalculates its deadline after the speed factor or emulated time changes.
+struct ClockChangedAction {
+};
+
+using Action = std::variant<AddTimerAction, RemoveTimerAction, ClockChangedAction>;
 
 struct {
     std::thread thread;
@@ -58,12 +77,45 @@ std::chrono::microseconds ticks_to_duration(uint64_t ticks) {
     return ticks * 1000us / counter_per_ms;
 }
 
+// Scales a duration by numerator/denominator without overflowing for large durations.
+static std::chrono::nanoseconds scale_duration(std::chrono::nanoseconds duration, uint32_t numerator, uint32_t denominator) {
+    int64_t count = duration.count();
+    return std::chrono::nanoseconds{ (count / denominator) * numerator + (count % denominator) * numerator / denominator };
+}
+
+// Must be called with the emulated clock's mutex held.
+static std::chrono::nanoseconds emulated_time_at(std::chrono::high_resolution_clock::time_point host_time) {
+    auto host_elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(host_time - emulated_clock.host_anchor);
+    if (emulated_clock.factor.uncapped) {
+        return emulated_clock.emulated_anchor + host_elapsed;
+    }
+    return emulated_clock.emulated_anchor + scale_duration(host_elapsed, emulated_clock.factor.numerator, emulated_clock.factor.denominator);
+}
+
+std::chrono::nanoseconds ultramodern::emulated_time_since_start() {
+    auto host_now = std::chrono::high_resolution_clock::now();
+    std::lock_guard lock{ emulated_clock.mutex };
+    return emulated_time_at(host_now);
+}
+
+std::chrono::high_resolution_clock::time_point ultramodern::emulated_to_host_time(std::chrono::nanoseconds emulated_time) {
+    std::lock_guard lock{ emulated_clock.mutex };
+    auto emulated_delta = emulated_time - emulated_clock.emulated_anchor;
+    if (emulated_delta.count() <= 0) {
+        return emulated_clock.host_anchor;
+    }
+    if (emulated_clock.factor.uncapped) {
+        return emulated_clock.host_anchor + emulated_delta;
+    }
+    return emulated_clock.host_anchor + scale_duration(emulated_delta, emulated_clock.factor.denominator, emulated_clock.factor.numerator);
+}
+
 std::chrono::high_resolution_clock::time_point ticks_to_timepoint(uint64_t ticks) {
-    return start_time + ticks_to_duration(ticks);
+    return ultramodern::emulated_to_host_time(ticks_to_duration(ticks));
 }
 
 uint64_t time_now() {
-    return duration_to_ticks(std::chrono::high_resolution_clock::now() - start_time);
+    return duration_to_ticks(ultramodern::emulated_time_since_start());
 }
 
 void timer_thread(RDRAM_ARG1) {
@@ -95,6 +147,7 @@ void timer_thread(RDRAM_ARG1) {
         } else if (const auto* remove_action = std::get_if<RemoveTimerAction>(&action)) {
             active_timers.erase(remove_action->timer);
         }
+        // ClockChangedAction needs no handling, as the deadline is recalculated on the next iteration.
     };
 
     while (true) {
@@ -145,8 +198,41 @@ void ultramodern::init_timers(RDRAM_ARG1) {
     timer_context.thread.detach();
 }
 
-uint32_t ultramodern::get_speed_multiplier() {
-    return speed_multiplier;
+void ultramodern::set_speed_factor(const SpeedFactor& factor) {
+    if (factor.numerator == 0 || factor.denominator == 0) {
+        fprintf(stderr, "[WARN] Ignoring invalid speed factor %" PRIu32 "/%" PRIu32 "\n", factor.numerator, factor.denominator);
+        return;
+    }
+
+    {
+        auto host_now = std::chrono::high_resolution_clock::now();
+        std::lock_guard lock{ emulated_clock.mutex };
+        emulated_clock.emulated_anchor = emulated_time_at(host_now);
+        emulated_clock.host_anchor = host_now;
+        emulated_clock.factor = factor;
+    }
+
+    timer_context.action_queue.enqueue(ClockChangedAction{});
+}
+
+ultramodern::SpeedFactor ultramodern::get_speed_factor() {
+    std::lock_guard lock{ emulated_clock.mutex };
+    return emulated_clock.factor;
+}
+
+void ultramodern::advance_emulated_time(std::chrono::nanoseconds emulated_time) {
+    {
+        auto host_now = std::chrono::high_resolution_clock::now();
+        std::lock_guard lock{ emulated_clock.mutex };
+        if (emulated_time <= emulated_time_at(host_now)) {
+            return;
+        }
+        emulated_clock.emulated_anchor = emulated_time;
+        emulated_clock.host_anchor = host_now;
+    }
+
+    // Timers may have become due as a result of the jump.
+    timer_context.action_queue.enqueue(ClockChangedAction{});
 }
 
 std::chrono::high_resolution_clock::time_point ultramodern::get_start() {
@@ -204,6 +290,19 @@ extern "C" int osStopTimer(RDRAM_ARG PTR(OSTimer) t_) {
     return 0;
 }
 
+static std::mutex pacing_control_mutex;
+static ultramodern::PacingControl pacing_control{};
+
+void ultramodern::set_pacing_control(const PacingControl& control) {
+    std::lock_guard lock{ pacing_control_mutex };
+    pacing_control = control;
+}
+
+static ultramodern::PacingControl get_pacing_control() {
+    std::lock_guard lock{ pacing_control_mutex };
+    return pacing_control;
+}
+
 #ifdef _WIN32
 
 // The implementations of std::chrono::sleep_until and sleep_for were affected by changing the system clock backwards in older versions
@@ -212,12 +311,15 @@ void ultramodern::sleep_milliseconds(uint32_t millis) {
     Sleep(millis);
 }
 
-void ultramodern::sleep_until(const std::chrono::high_resolution_clock::time_point& time_point) {
+// Sleeps until at least the given time point. Sleep only has millisecond granularity, so this rounds up. Rounding down instead
+// would stretch the spin that follows by up to a millisecond.
+static void coarse_sleep_until(const std::chrono::high_resolution_clock::time_point& time_point, bool reduce_timer_slack) {
     auto time_now = std::chrono::high_resolution_clock::now();
     if (time_point > time_now) {
         long long delta_ms = std::chrono::ceil<std::chrono::milliseconds>(time_point - time_now).count();
-        // printf("Sleeping %lld %d ms\n", delta_ms, (uint32_t)delta_ms);
-        Sleep(delta_ms);
+        if (delta_ms > 0) {
+            Sleep(delta_ms);
+        }
     }
 }
 
@@ -227,8 +329,75 @@ void ultramodern::sleep_milliseconds(uint32_t millis) {
     std::this_thread::sleep_for(std::chrono::milliseconds{millis});
 }
 
-void ultramodern::sleep_until(const std::chrono::high_resolution_clock::time_point& time_point) {
+static void coarse_sleep_until(const std::chrono::high_resolution_clock::time_point& time_point, bool reduce_timer_slack) {
+#   ifdef __linux__
+    // Timer slack is per-thread and defaults to 50us, which gets added onto every sleep.
+    thread_local bool timer_slack_reduced = false;
+    if (reduce_timer_slack && !timer_slack_reduced) {
+        prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+        timer_slack_reduced = true;
+    }
+
+    // high_resolution_clock may be the realtime clock, so convert the deadline to an absolute monotonic time so
+    // the sleep isn't affected by changes to the system time.
+    auto time_now = std::chrono::high_resolution_clock::now();
+    if (time_point <= time_now) {
+        return;
+    }
+    uint64_t delta_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(time_point - time_now).count();
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    uint64_t deadline_ns = uint64_t(deadline.tv_nsec) + delta_ns;
+    deadline.tv_sec += deadline_ns / 1'000'000'000;
+    deadline.tv_nsec = deadline_ns % 1'000'000'000;
+
+    // Retry if interrupted by a signal, as the deadline is absolute.
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {}
+#   else
+    (void)reduce_timer_slack;
     std::this_thread::sleep_until(time_point);
+#   endif
 }
 
 #endif
+
+// Whether the calling thread runs with a realtime scheduling policy. Yielding from a realtime thread never gives the CPU to
+// normal threads, so spinning would starve them, and realtime threads already wake up with little latency.
+static bool is_realtime_thread() {
+#ifdef __linux__
+    int policy = sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+    return policy == SCHED_FIFO || policy == SCHED_RR;
+#else
+    return false;
+#endif
+}
+
+void ultramodern::sleep_until(const std::chrono::high_resolution_clock::time_point& time_point) {
+    ultramodern::PacingControl control = get_pacing_control();
+
+    if (control.spin_window.count() <= 0 || is_realtime_thread()) {
+        coarse_sleep_until(time_point, control.reduce_timer_slack);
+        return;
+    }
+
+    // Moving average of how late this thread's sleeps wake up. Spinning for longer than the scheduler actually oversleeps
+    // only burns CPU, so the spin window is bounded by twice this. Starts at half of the configured window so that the
+    // first sleeps use all of it.
+    thread_local std::chrono::nanoseconds average_oversleep{ control.spin_window / 2 };
+    std::chrono::nanoseconds spin_window = std::min<std::chrono::nanoseconds>(control.spin_window, average_oversleep * 2);
+
+    // Sleep until the start of the spin window, then spin for the rest to avoid oversleeping from scheduler wakeup latency.
+    auto sleep_target = time_point - spin_window;
+    coarse_sleep_until(sleep_target, control.reduce_timer_slack);
+
+    auto wake_time = std::chrono::high_resolution_clock::now();
+    if (wake_time > sleep_target) {
+        std::chrono::nanoseconds oversleep = wake_time - sleep_target;
+        average_oversleep += (oversleep - average_oversleep) / 8;
+    }
+
+    while (std::chrono::high_resolution_clock::now() < time_point) {
+        std::this_thread::yield();
+    }
+}